@@ -10,7 +10,8 @@ _wk() {
 
     # Options that take integer arguments
     local int_opts='-D --delay -m --max-columns -w --menu-width -g --menu-gap
-                    --keep-delay --border-width --wpadding --hpadding --table-padding'
+                    --keep-delay --border-width --wpadding --hpadding --table-padding
+                    --render-threads'
 
     # Options that take number arguments (float)
     local num_opts='--border-radius'
@@ -28,10 +29,11 @@ _wk() {
 
     # All options
     local all_opts='-h --help -v --version -d --debug -t --top -b --bottom
-                    -c --center -s --script -U --unsorted
+                    -c --center -s --script -U --unsorted --no-cache --client-render --runner
+                    --prefetch
                     -D --delay -m --max-columns -p --press -T --transpile
-                    -k --key-chords -w --menu-width -g --menu-gap
-                    --keep-delay --border-width --border-radius
+                    -k --key-chords --latency --trace -w --menu-width -g --menu-gap
+                    --keep-delay --render-threads --border-width --border-radius
                     --wpadding --hpadding --table-padding
                     --fg --fg-key --fg-delimiter --fg-prefix --fg-chord
                     --fg-title --fg-goto --fg-header --bg --bd
@@ -44,14 +46,14 @@ _wk() {
             _filedir wks
             return
             ;;
-        --shell)
-            # Complete executable paths
+        --shell|--latency|--trace)
+            # Complete any path
             _filedir
             return
             ;;
         -D|--delay|-m|--max-columns|-w|--menu-width|-g|--menu-gap|\
         --keep-delay|--border-width|--wpadding|--hpadding|--table-padding|\
-        --border-radius)
+        --border-radius|--render-threads)
             # Numeric arguments - no completion
             return
             ;;
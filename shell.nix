@@ -53,6 +53,7 @@ pkgs.mkShell {
     echo "Build commands:"
     echo "  make          - Build wk for X11 and Wayland"
     echo "  make x11      - Build wk for X11 only"
+    echo "  make xcb      - Build wk for X11 only, using XCB"
     echo "  make wayland  - Build wk for Wayland only"
     echo "  make debug    - Build with debug symbols"
     echo "  make test     - Run test suite"
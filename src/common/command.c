@@ -0,0 +1,201 @@
+#define _GNU_SOURCE /* POSIX_SPAWN_SETSID */
+
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* local includes */
+#include "arena.h"
+#include "command.h"
+#include "string.h"
+
+static bool
+isBlank(unsigned char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+/* Characters a shell passes through untouched. Anything else may quote,
+ * expand, redirect, or separate commands, so it is left to the shell. */
+static bool
+isPlain(unsigned char c)
+{
+    if (c >= 0x80 || isalnum(c)) return true;
+
+    switch (c)
+    {
+    case '_': /* FALLTHROUGH */
+    case '-':
+    case '.':
+    case '/':
+    case ',':
+    case ':':
+    case '+':
+    case '@':
+    case '%':
+    case '=': return true;
+    default: return false;
+    }
+}
+
+void
+commandClassify(Command* command, Arena* arena, String line)
+{
+    assert(command), assert(arena);
+
+    command->line = line;
+    command->argv = NULL;
+    command->path = NULL;
+
+    size_t words  = 0;
+    bool   inWord = false;
+    for (size_t i = 0; i < line.length; i++)
+    {
+        unsigned char c = line.data[i];
+        if (isBlank(c))
+        {
+            inWord = false;
+            continue;
+        }
+
+        if (!inWord)
+        {
+            inWord = true;
+            words++;
+        }
+
+        /* An '=' in the first word makes it a variable assignment. */
+        if (!isPlain(c) || (c == '=' && words == 1))
+        {
+            command->kind = COMMAND_SHELL;
+            return;
+        }
+    }
+
+    if (words == 0)
+    {
+        command->kind = COMMAND_EMPTY;
+        return;
+    }
+
+    char*  copy = arenaCopyCString(arena, line.data, line.length);
+    char** argv = ARENA_ALLOCATE(arena, char*, words + 1);
+    size_t argc = 0;
+
+    inWord = false;
+    for (char* p = copy; *p; p++)
+    {
+        if (isBlank(*p))
+        {
+            *p     = '\0';
+            inWord = false;
+        }
+        else if (!inWord)
+        {
+            argv[argc++] = p;
+            inWord       = true;
+        }
+    }
+    argv[argc] = NULL;
+
+    command->kind = COMMAND_DIRECT;
+    command->argv = argv;
+}
+
+const char*
+commandKindRepr(CommandKind kind)
+{
+    switch (kind)
+    {
+    case COMMAND_UNCLASSIFIED: return "unclassified";
+    case COMMAND_EMPTY: return "empty";
+    case COMMAND_DIRECT: return "direct";
+    case COMMAND_SHELL: return "shell";
+    default: return "unknown";
+    }
+}
+
+static bool
+isExecutable(const char* path)
+{
+    assert(path);
+
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+/* Find the program of a direct command once. Shell builtins and missing
+ * programs are not on PATH, those commands are handed to the shell from
+ * then on so it can run them or report the error. */
+bool
+commandResolvePath(Command* command, Arena* arena)
+{
+    assert(command), assert(arena), assert(command->kind == COMMAND_DIRECT);
+
+    if (command->path) return true;
+
+    const char* name = command->argv[0];
+    if (strchr(name, '/'))
+    {
+        if (isExecutable(name)) command->path = name;
+    }
+    else
+    {
+        const char* dirs    = getenv("PATH");
+        size_t      nameLen = strlen(name);
+        if (!dirs) dirs = "/usr/local/bin:/usr/bin:/bin";
+
+        while (!command->path && *dirs)
+        {
+            const char* end    = strchr(dirs, ':');
+            size_t      dirLen = end ? (size_t)(end - dirs) : strlen(dirs);
+            char        path[PATH_MAX];
+
+            if (dirLen + nameLen + 3 <= sizeof(path))
+            {
+                /* An empty entry means the working directory. */
+                int len = dirLen ? (int)dirLen : 1;
+                snprintf(path, sizeof(path), "%.*s/%s", len, dirLen ? dirs : ".", name);
+                if (isExecutable(path)) command->path = arenaCopyCString(arena, path, strlen(path));
+            }
+
+            dirs += dirLen;
+            if (*dirs == ':') dirs++;
+        }
+    }
+
+    if (!command->path) command->kind = COMMAND_SHELL;
+    return command->path != NULL;
+}
+
+/* Start a program in a new session without copying the caller's address
+ * space. Descriptors wk holds open are all close-on-exec, so the child only
+ * keeps the standard streams. Returns 0 or an errno value. */
+int
+commandSpawn(const char* file, char* const argv[], pid_t* pid)
+{
+    assert(file), assert(argv), assert(pid);
+
+    posix_spawnattr_t attr;
+    sigset_t          mask;
+    int               err = posix_spawnattr_init(&attr);
+
+    if (err) return err;
+
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK);
+
+    err = posix_spawnp(pid, file, NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    return err;
+}
@@ -0,0 +1,35 @@
+#ifndef WK_COMMON_COMMAND_H_
+#define WK_COMMON_COMMAND_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/* local includes */
+#include "arena.h"
+#include "string.h"
+
+typedef enum
+{
+    COMMAND_UNCLASSIFIED,
+    COMMAND_EMPTY,
+    COMMAND_DIRECT,
+    COMMAND_SHELL,
+} CommandKind;
+
+/* A command line as it will be run. Lines made of plain words only are split
+ * into 'argv' and exec'ed without a shell, 'path' caches the program found
+ * on PATH the first time one runs. Everything is arena-owned. */
+typedef struct
+{
+    CommandKind kind;
+    String      line;
+    char**      argv;
+    const char* path;
+} Command;
+
+void        commandClassify(Command* command, Arena* arena, String line);
+const char* commandKindRepr(CommandKind kind);
+bool        commandResolvePath(Command* command, Arena* arena);
+int         commandSpawn(const char* file, char* const argv[], pid_t* pid);
+
+#endif /* WK_COMMON_COMMAND_H_ */
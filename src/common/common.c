@@ -5,12 +5,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 /* local includes */
 #include "arena.h"
 #include "common.h"
 #include "string.h"
 
+#define FNV_PRIME 0x100000001b3ULL
+
+/* Milliseconds on the monotonic clock since 'start'. */
+double
+elapsedMs(const struct timespec* start)
+{
+    assert(start);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000.0 + (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
 void
 errorMsg(const char* fmt, ...)
 {
@@ -34,6 +48,21 @@ getSeparator(int* count, const char* a, const char* b)
     return ((*count)-- > 1 ? a : b);
 }
 
+/* Fold 'size' bytes of 'data' into the FNV-1a hash 'hash'. A new hash starts
+ * from FNV_OFFSET_BASIS. */
+uint64_t
+hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+
+    return hash;
+}
+
 bool
 isUtf8ContByte(char byte)
 {
@@ -2,13 +2,20 @@
 #define WK_COMMON_COMMON_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 /* common includes */
 #include "arena.h"
 #include "string.h"
 
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+
+double      elapsedMs(const struct timespec* start);
 void        errorMsg(const char* fmt, ...);
 const char* getSeparator(int* count, const char* a, const char* b);
+uint64_t    hashBytes(uint64_t hash, const void* data, size_t size);
 bool        isUtf8ContByte(char byte);
 bool        isUtf8MultiByteStartByte(char byte);
 bool        isUtf8StartByte(char byte);
@@ -6,6 +6,7 @@
 #include <string.h>
 
 /* local includes */
+#include "command.h"
 #include "common.h"
 #include "debug.h"
 #include "key_chord.h"
@@ -287,6 +288,13 @@ disassembleKeyChord(const KeyChord* keyChord, int indent)
     debugStringWithIndent(indent, "Wrap Command:", propStringConst(keyChord, KC_PROP_WRAP_CMD));
     debugStringWithIndent(indent, "Title", propStringConst(keyChord, KC_PROP_TITLE));
     debugStringWithIndent(indent, "Group:", propStringConst(keyChord, KC_PROP_GROUP));
+    debugMsgWithIndent(
+        indent,
+        "| %-20s before: %s, command: %s, after: %s",
+        "Exec:",
+        commandKindRepr(keyChord->exec[KC_EXEC_BEFORE].kind),
+        commandKindRepr(keyChord->exec[KC_EXEC_COMMAND].kind),
+        commandKindRepr(keyChord->exec[KC_EXEC_AFTER].kind));
     disassembleChordFlag(keyChord->flags, indent);
 }
 
@@ -460,12 +468,17 @@ disassembleMenu(const Menu* menu)
     debugMsgWithIndent(0, "| %-20s %04u", "Title height:", menu->titleHeight);
     debugMsgWithIndent(0, "| %-20s %04u", "Rows:", menu->rows);
     debugMsgWithIndent(0, "| %-20s %04u", "Cols:", menu->cols);
+    debugMsgWithIndent(0, "| %-20s %04u", "Page:", menu->page);
+    debugMsgWithIndent(0, "| %-20s %04u", "Page count:", menu->pageCount);
     debugMsgWithIndent(0, "| %-20s %04u", "Width:", menu->width);
     debugMsgWithIndent(0, "| %-20s %04u", "Height:", menu->height);
     debugMsgWithIndent(0, "| %-20s %04u", "Border width:", menu->borderWidth);
     debugMsgWithIndent(0, "| %-20s %04u", "Delay:", menu->delay);
     debugMsgWithIndent(0, "| %-20s %04u", "Keep Delay:", menu->keepDelay);
+    debugMsgWithIndent(0, "| %-20s %04u", "Render threads:", menu->renderThreads);
     debugMsgWithIndent(0, "| %-20s '%s'", "Wrap Cmd:", menu->wrapCmd ? menu->wrapCmd : "(null)");
+    debugMsgWithIndent(0, "| %-20s '%s'", "Latency file:", menu->latencyFile ? menu->latencyFile : "(null)");
+    debugMsgWithIndent(0, "| %-20s '%s'", "Trace file:", menu->trace.path ? menu->trace.path : "(null)");
     const char* positionStr = "TOP";
     switch (menu->position)
     {
@@ -480,6 +493,10 @@ disassembleMenu(const Menu* menu)
         positionStr);
     debugMsgWithIndent(0, "| %-20s %s", "Debug:", "true");
     debugMsgWithIndent(0, "| %-20s %s", "Sort:", menu->sort ? "true" : "false");
+    debugMsgWithIndent(0, "| %-20s %s", "Cache:", menu->cache ? "true" : "false");
+    debugMsgWithIndent(0, "| %-20s %s", "Client render:", menu->clientRender ? "true" : "false");
+    debugMsgWithIndent(0, "| %-20s %s", "Runner:", menu->useRunner ? "true" : "false");
+    debugMsgWithIndent(0, "| %-20s %s", "Prefetch:", menu->usage.enabled ? "true" : "false");
     debugMsgWithIndent(0, "| %-20s %s", "Dirty:", menu->dirty ? "true" : "false");
     debugMsgWithIndent(0, "|");
     debugPrintHeader("");
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
 /* local includes */
 #include "key_chord.h"
@@ -27,6 +28,7 @@ keyChordCopy(const KeyChord* from, KeyChord* to)
 
     to->flags     = from->flags;
     to->keyChords = from->keyChords;
+    memcpy(to->exec, from->exec, sizeof(to->exec));
 }
 
 void
@@ -56,6 +58,7 @@ keyChordInit(KeyChord* keyChord)
 
     keyChord->flags     = chordFlagInit();
     keyChord->keyChords = SPAN_EMPTY;
+    memset(keyChord->exec, 0, sizeof(keyChord->exec));
 }
 
 void
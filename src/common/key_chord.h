@@ -7,6 +7,7 @@
 
 /* common includes */
 #include "chord_flag.h"
+#include "command.h"
 #include "key.h"
 #include "key_chord_def.h"
 #include "property.h"
@@ -20,12 +21,22 @@ typedef enum
         KC_PROP_COUNT
 } PropId;
 
+/* Commands a chord runs, classified once their lines are final */
+typedef enum
+{
+    KC_EXEC_BEFORE,
+    KC_EXEC_COMMAND,
+    KC_EXEC_AFTER,
+    KC_EXEC_COUNT
+} ExecId;
+
 typedef struct KeyChord
 {
     Key       key;
     Property  props[KC_PROP_COUNT];
     ChordFlag flags;
     Span      keyChords;
+    Command   exec[KC_EXEC_COUNT];
 } KeyChord;
 
 void            keyChordCopy(const KeyChord* from, KeyChord* to);
@@ -0,0 +1,251 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* local includes */
+#include "common.h"
+#include "latency.h"
+
+static const char* stageNames[LATENCY_STAGE_COUNT] = {
+    [LATENCY_HANDLED]   = "handled",
+    [LATENCY_PAINTED]   = "painted",
+    [LATENCY_COMMITTED] = "committed",
+    [LATENCY_PRESENTED] = "presented",
+};
+
+static uint64_t
+elapsedUs(const struct timespec* start, const struct timespec* end)
+{
+    assert(start), assert(end);
+
+    int64_t ns = ((int64_t)(end->tv_sec - start->tv_sec) * 1000000000) + (end->tv_nsec - start->tv_nsec);
+    return ns > 0 ? (uint64_t)ns / 1000 : 0;
+}
+
+static void
+record(LatencyHistogram* histogram, uint64_t us)
+{
+    assert(histogram);
+
+    size_t bucket = 0;
+    while (bucket + 1 < LATENCY_BUCKET_COUNT && us >= ((uint64_t)2 << bucket)) bucket++;
+
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->totalUs += us;
+    if (us > histogram->maxUs) histogram->maxUs = us;
+}
+
+static void
+recordFrame(Latency* latency, LatencyStage stage, const LatencyFrame* frame, const struct timespec* when)
+{
+    assert(latency), assert(frame), assert(when);
+
+    for (size_t i = 0; i < frame->count; i++)
+    {
+        record(&latency->stages[stage], elapsedUs(&frame->keys[i], when));
+    }
+}
+
+/* Key event times are milliseconds on the X server's or the compositor's
+ * clock, which is CLOCK_MONOTONIC on Linux in practice. A time that does
+ * not fit that clock is ignored and the key counts from when wk read it. */
+static struct timespec
+receivedAt(uint32_t eventTime)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint32_t nowMs = (uint32_t)((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+    uint32_t age   = nowMs - eventTime;
+    if (!eventTime || age > 10000) return now;
+
+    struct timespec received = now;
+    received.tv_sec -= age / 1000;
+    received.tv_nsec -= (long)(age % 1000) * 1000000;
+    if (received.tv_nsec < 0)
+    {
+        received.tv_sec--;
+        received.tv_nsec += 1000000000;
+    }
+
+    return received;
+}
+
+/* The frame showing the pending keys went out. They are handed to
+ * 'presented' to be matched with the compositor's report, if given. */
+void
+latencyCommit(Latency* latency, LatencyFrame* presented)
+{
+    assert(latency);
+
+    if (!latency->enabled) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    recordFrame(latency, LATENCY_COMMITTED, &latency->frame, &now);
+
+    if (presented) *presented = latency->frame;
+    latency->frame.count = 0;
+}
+
+/* The menu handled the last key. Keys that change nothing on screen are
+ * not waited on. */
+void
+latencyHandled(Latency* latency, bool redraw)
+{
+    assert(latency);
+
+    if (!latency->enabled || !latency->keyPending) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record(&latency->stages[LATENCY_HANDLED], elapsedUs(&latency->key, &now));
+
+    if (redraw && latency->frame.count < LATENCY_FRAME_KEYS)
+    {
+        latency->frame.keys[latency->frame.count++] = latency->key;
+    }
+    latency->keyPending = false;
+}
+
+void
+latencyInit(Latency* latency)
+{
+    assert(latency);
+
+    memset(latency, 0, sizeof(Latency));
+}
+
+void
+latencyKey(Latency* latency, uint32_t eventTime)
+{
+    assert(latency);
+
+    if (!latency->enabled) return;
+
+    latency->key        = receivedAt(eventTime);
+    latency->keyPending = true;
+}
+
+void
+latencyPainted(Latency* latency)
+{
+    assert(latency);
+
+    if (!latency->enabled) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    recordFrame(latency, LATENCY_PAINTED, &latency->frame, &now);
+}
+
+void
+latencyPresented(Latency* latency, const LatencyFrame* frame, const struct timespec* when)
+{
+    assert(latency), assert(frame), assert(when);
+
+    if (!latency->enabled) return;
+
+    recordFrame(latency, LATENCY_PRESENTED, frame, when);
+}
+
+/* The upper bound of the bucket holding the 'p'th percentile, in ms. */
+static double
+percentileMs(const LatencyHistogram* histogram, double p)
+{
+    assert(histogram);
+
+    uint64_t target = (uint64_t)(p * histogram->count + 0.5);
+    uint64_t seen   = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        seen += histogram->buckets[i];
+        if (seen >= target && seen > 0)
+        {
+            uint64_t bound = (uint64_t)2 << i;
+            return (bound < histogram->maxUs ? bound : histogram->maxUs) / 1000.0;
+        }
+    }
+
+    return histogram->maxUs / 1000.0;
+}
+
+static void
+writeHistogram(FILE* file, const char* name, const LatencyHistogram* histogram)
+{
+    assert(file), assert(name), assert(histogram);
+
+    uint64_t peak = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        if (histogram->buckets[i] > peak) peak = histogram->buckets[i];
+    }
+
+    fprintf(file, "\n%s:\n", name);
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        if (!histogram->buckets[i]) continue;
+
+        int bar = (int)((histogram->buckets[i] * 40 + peak - 1) / peak);
+        fprintf(
+            file,
+            "  %9.3f ms %c %8llu %.*s\n",
+            (i ? (uint64_t)1 << i : 0) / 1000.0,
+            i + 1 < LATENCY_BUCKET_COUNT ? '+' : '>',
+            (unsigned long long)histogram->buckets[i],
+            bar,
+            "########################################");
+    }
+}
+
+/* Write the histograms to 'path', or to stderr when it is '-'. */
+bool
+latencyWrite(const Latency* latency, const char* path)
+{
+    assert(latency), assert(path);
+
+    bool  toStderr = strcmp(path, "-") == 0;
+    FILE* file     = toStderr ? stderr : fopen(path, "w");
+    if (!file)
+    {
+        errorMsg("Could not open '%s' for the latency report: %s.", path, strerror(errno));
+        return false;
+    }
+
+    fprintf(
+        file,
+        "wk %s key-to-photon latency, %llu keys\n\n",
+        VERSION,
+        (unsigned long long)latency->stages[LATENCY_HANDLED].count);
+    fprintf(file, "%-10s %8s %9s %9s %9s %9s %9s\n", "stage", "count", "mean", "p50", "p90", "p99", "max ms");
+    for (size_t i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        const LatencyHistogram* histogram = &latency->stages[i];
+        if (!histogram->count) continue;
+
+        fprintf(
+            file,
+            "%-10s %8llu %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+            stageNames[i],
+            (unsigned long long)histogram->count,
+            (double)histogram->totalUs / histogram->count / 1000.0,
+            percentileMs(histogram, 0.50),
+            percentileMs(histogram, 0.90),
+            percentileMs(histogram, 0.99),
+            histogram->maxUs / 1000.0);
+    }
+
+    for (size_t i = 0; i < LATENCY_STAGE_COUNT; i++)
+    {
+        if (latency->stages[i].count) writeHistogram(file, stageNames[i], &latency->stages[i]);
+    }
+
+    if (toStderr) return true;
+    return fclose(file) == 0;
+}
@@ -0,0 +1,59 @@
+#ifndef WK_COMMON_LATENCY_H_
+#define WK_COMMON_LATENCY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Bucket 'i' counts samples of [2^i, 2^(i+1)) microseconds, the last one
+ * everything above. */
+#define LATENCY_BUCKET_COUNT 24
+#define LATENCY_FRAME_KEYS   32
+
+typedef enum
+{
+    LATENCY_HANDLED,
+    LATENCY_PAINTED,
+    LATENCY_COMMITTED,
+    LATENCY_PRESENTED,
+    LATENCY_STAGE_COUNT,
+} LatencyStage;
+
+/* Keys waiting for the next frame, by the time they were received. */
+typedef struct
+{
+    struct timespec keys[LATENCY_FRAME_KEYS];
+    size_t          count;
+} LatencyFrame;
+
+typedef struct
+{
+    uint64_t buckets[LATENCY_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t totalUs;
+    uint64_t maxUs;
+} LatencyHistogram;
+
+/* Key-to-photon latency over one session. Each key is timed from its
+ * arrival to when the menu handled it, and then to when the frame showing
+ * it was painted, flushed or committed, and presented, if the backend
+ * reports that. */
+typedef struct
+{
+    LatencyFrame     frame;
+    struct timespec  key;
+    LatencyHistogram stages[LATENCY_STAGE_COUNT];
+    bool             keyPending;
+    bool             enabled;
+} Latency;
+
+void latencyCommit(Latency* latency, LatencyFrame* presented);
+void latencyHandled(Latency* latency, bool redraw);
+void latencyInit(Latency* latency);
+void latencyKey(Latency* latency, uint32_t eventTime);
+void latencyPainted(Latency* latency);
+void latencyPresented(Latency* latency, const LatencyFrame* frame, const struct timespec* when);
+bool latencyWrite(const Latency* latency, const char* path);
+
+#endif /* WK_COMMON_LATENCY_H_ */
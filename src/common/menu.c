@@ -8,12 +8,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sysexits.h>
 #include <time.h>
 #include <unistd.h>
 
-#ifdef WK_X11_BACKEND
+#if defined(WK_XCB_BACKEND)
+#include "runtime/xcb/window.h"
+#elif defined(WK_X11_BACKEND)
 #include "runtime/x11/window.h"
 #endif
 
@@ -26,12 +29,16 @@
 
 /* common includes */
 #include "arena.h"
+#include "command.h"
 #include "common.h"
 #include "debug.h"
 #include "key_chord.h"
+#include "latency.h"
 #include "span.h"
 #include "stack.h"
 #include "string.h"
+#include "trace.h"
+#include "usage.h"
 #include "vector.h"
 
 /* local includes */
@@ -67,6 +74,13 @@ enum
     OPT_ARG_KEEP_DELAY,
     OPT_ARG_HEADER_ALIGN,
     OPT_ARG_HEADER_FONT,
+    OPT_ARG_NO_CACHE,
+    OPT_ARG_RENDER_THREADS,
+    OPT_ARG_CLIENT_RENDER,
+    OPT_ARG_RUNNER,
+    OPT_ARG_LATENCY,
+    OPT_ARG_TRACE,
+    OPT_ARG_PREFETCH,
 };
 
 int
@@ -82,6 +96,17 @@ menuDisplay(Menu* menu)
 
     menuResetTimer(menu);
 
+    /* Fork the runner while wk is still small, before the backend loads. */
+    if (menu->useRunner && runnerStart(&menu->runner))
+    {
+        debugMsg(menu->debug, "Started the command runner.");
+    }
+
+    if (usageOpen(&menu->usage, menu->keyChordsHead))
+    {
+        debugMsg(menu->debug, "Counting chord presses for prefetch.");
+    }
+
 #ifdef WK_WAYLAND_BACKEND
     if (getenv("WAYLAND_DISPLAY") || getenv("WAYLAND_SOCKET"))
     {
@@ -89,7 +114,10 @@ menuDisplay(Menu* menu)
         return waylandRun(menu);
     }
 #endif
-#ifdef WK_X11_BACKEND
+#if defined(WK_XCB_BACKEND)
+    debugMsg(menu->debug, "Running on x11 (xcb).");
+    return xcbRun(menu);
+#elif defined(WK_X11_BACKEND)
     debugMsg(menu->debug, "Running on x11.");
     return x11Run(menu);
 #endif
@@ -105,6 +133,11 @@ menuFree(Menu* menu)
     keyChordsFree(&menu->compiledKeyChords);
     vectorFree(&menu->userVars);
     arenaFree(&menu->arena);
+    runnerStop(&menu->runner);
+    vectorFree(&menu->pipeline.steps);
+    if (menu->pipeline.pidfd >= 0) close(menu->pipeline.pidfd);
+    traceFree(&menu->trace);
+    usageClose(&menu->usage);
 }
 
 static MenuStatus
@@ -115,6 +148,7 @@ menuHandlePrefix(Menu* menu, KeyChord* keyChord)
     debugMsg(menu->debug, "Found prefix.");
 
     menu->keyChords = &keyChord->keyChords;
+    menu->page      = 0;
     if (propIsSet(keyChord, KC_PROP_TITLE))
     {
         const String* title = propStringConst(keyChord, KC_PROP_TITLE);
@@ -150,6 +184,8 @@ menuHandleGoto(Menu* menu, KeyChord* keyChord)
     /* Reset to root */
     menu->keyChords = menu->keyChordsHead;
     menu->title     = menu->rootTitle;
+    menu->page      = 0;
+    usageReset(&menu->usage);
 
     const String* gotoPath = propStringConst(keyChord, KC_PROP_GOTO);
     MenuStatus    status;
@@ -170,17 +206,22 @@ menuHandleGoto(Menu* menu, KeyChord* keyChord)
     return status;
 }
 
-static void
-menuHandleCommand(Menu* menu, KeyChord* keyChord)
+/* The line a chord runs for 'id'. Hooks run as written, the command runs
+ * behind the chord's or the menu's wrapper unless the chord is +unwrap. */
+static String
+menuCommandLine(Menu* menu, const KeyChord* keyChord, ExecId id)
 {
-    assert(menu), assert(keyChord);
+    assert(menu), assert(keyChord), assert(id < KC_EXEC_COUNT);
 
-    if (chordFlagIsActive(keyChord->flags, FLAG_WRITE))
-    {
-        const String* cmd = propStringConst(keyChord, KC_PROP_COMMAND);
-        if (cmd) printf("%s\n", cmd->data);
-        return;
-    }
+    static const PropId props[KC_EXEC_COUNT] = {
+        [KC_EXEC_BEFORE]  = KC_PROP_BEFORE,
+        [KC_EXEC_COMMAND] = KC_PROP_COMMAND,
+        [KC_EXEC_AFTER]   = KC_PROP_AFTER,
+    };
+
+    String        empty  = { .data = "", .length = 0 };
+    const String* cmdStr = propStringConst(keyChord, props[id]);
+    if (id != KC_EXEC_COMMAND) return stringIsEmpty(cmdStr) ? empty : *cmdStr;
 
     const char* wrapData = NULL;
     size_t      wrapLen  = 0;
@@ -203,28 +244,24 @@ menuHandleCommand(Menu* menu, KeyChord* keyChord)
         }
     }
 
-    const char*   cmdData = NULL;
-    size_t        cmdLen  = 0;
-    const String* cmdStr  = propStringConst(keyChord, KC_PROP_COMMAND);
+    if (wrapLen == 0) return stringIsEmpty(cmdStr) ? empty : *cmdStr;
+
+    const char* cmdData = NULL;
+    size_t      cmdLen  = 0;
     if (!stringIsEmpty(cmdStr))
     {
         cmdData = cmdStr->data;
         cmdLen  = cmdStr->length;
     }
 
-    if (wrapLen == 0 && cmdLen == 0) return;
-
-    bool   needsSpace = (wrapLen > 0 && cmdLen > 0);
+    bool   needsSpace = cmdLen > 0;
     size_t totalLen   = wrapLen + cmdLen + (needsSpace ? 1 : 0);
-    char   buffer[totalLen + 1];
-    char*  p = buffer;
+    char*  buffer     = ARENA_ALLOCATE(&menu->arena, char, totalLen + 1);
+    char*  p          = buffer;
 
-    if (wrapLen > 0)
-    {
-        memcpy(p, wrapData, wrapLen);
-        p += wrapLen;
-        if (needsSpace) *p++ = ' ';
-    }
+    memcpy(p, wrapData, wrapLen);
+    p += wrapLen;
+    if (needsSpace) *p++ = ' ';
     if (cmdLen > 0)
     {
         memcpy(p, cmdData, cmdLen);
@@ -232,8 +269,50 @@ menuHandleCommand(Menu* menu, KeyChord* keyChord)
     }
     *p = '\0';
 
-    String cmd = { .data = buffer, .length = totalLen };
-    menuSpawn(menu, keyChord, &cmd, chordFlagIsActive(keyChord->flags, FLAG_SYNC_COMMAND));
+    return (String){ .data = buffer, .length = totalLen };
+}
+
+static Command*
+menuGetCommand(Menu* menu, KeyChord* keyChord, ExecId id)
+{
+    assert(menu), assert(keyChord), assert(id < KC_EXEC_COUNT);
+
+    Command* command = &keyChord->exec[id];
+    if (command->kind == COMMAND_UNCLASSIFIED)
+    {
+        commandClassify(command, &menu->arena, menuCommandLine(menu, keyChord, id));
+    }
+
+    return command;
+}
+
+void
+menuClassifyCommands(Menu* menu, KeyChord* keyChord)
+{
+    assert(menu), assert(keyChord);
+
+    for (ExecId id = 0; id < KC_EXEC_COUNT; id++)
+    {
+        menuGetCommand(menu, keyChord, id);
+    }
+}
+
+static void
+menuHandleCommand(Menu* menu, KeyChord* keyChord)
+{
+    assert(menu), assert(keyChord);
+
+    if (chordFlagIsActive(keyChord->flags, FLAG_WRITE))
+    {
+        const String* cmd = propStringConst(keyChord, KC_PROP_COMMAND);
+        if (cmd) menuWrite(menu, cmd);
+        return;
+    }
+
+    menuSpawn(
+        menu,
+        menuGetCommand(menu, keyChord, KC_EXEC_COMMAND),
+        chordFlagIsActive(keyChord->flags, FLAG_SYNC_COMMAND));
 }
 
 static MenuStatus
@@ -241,37 +320,62 @@ menuHandleCommands(Menu* menu, KeyChord* keyChord)
 {
     assert(menu), assert(keyChord);
 
+    /* Backends that hold the keyboard grab across keypresses release it
+     * here, so commands never start with the keyboard grabbed. */
+    if (menu->xp && menu->ungrabfp) menu->ungrabfp(menu->xp);
+
     menuSpawn(
         menu,
-        keyChord,
-        propStringConst(keyChord, KC_PROP_BEFORE),
+        menuGetCommand(menu, keyChord, KC_EXEC_BEFORE),
         chordFlagIsActive(keyChord->flags, FLAG_SYNC_BEFORE));
     menuHandleCommand(menu, keyChord);
     menuSpawn(
         menu,
-        keyChord,
-        propStringConst(keyChord, KC_PROP_AFTER),
+        menuGetCommand(menu, keyChord, KC_EXEC_AFTER),
         chordFlagIsActive(keyChord->flags, FLAG_SYNC_AFTER));
 
-    /* If chord has +keep flag and a command to execute, sleep to allow
-     * compositor to process the ungrab before the command executes */
+    /* If chord has +keep flag and a command to execute, give the command
+     * keepDelay ms without the keyboard grab. The backends take it back
+     * once the deadline passes, without blocking their event loop. */
     if (chordFlagIsActive(keyChord->flags, FLAG_KEEP) && propIsSet(keyChord, KC_PROP_COMMAND))
     {
-        struct timespec sleep_duration = {
-            .tv_sec  = 0,
-            .tv_nsec = menu->keepDelay * 1000000
-        };
-        nanosleep(&sleep_duration, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &menu->keepTimer);
+        menu->keepPending = menu->keepDelay > 0;
     }
 
     return chordFlagIsActive(keyChord->flags, FLAG_KEEP) ? MENU_STATUS_RUNNING : MENU_STATUS_EXIT_OK;
 }
 
+/* Page keys are only consulted when no chord matched, so a chord bound to
+ * Page_Up or Page_Down always takes precedence. */
+static bool
+menuHandlePageKey(Menu* menu, const Key* key)
+{
+    assert(menu), assert(key);
+
+    if (menu->pageCount <= 1 || modifierHasAnyActive(key->mods)) return false;
+
+    uint32_t page = menu->page;
+    switch (key->special)
+    {
+    case SPECIAL_KEY_PAGE_DOWN: page = (page + 1) % menu->pageCount; break;
+    case SPECIAL_KEY_PAGE_UP: page = (page + menu->pageCount - 1) % menu->pageCount; break;
+    default: return false;
+    }
+
+    debugMsg(menu->debug, "Showing page %u of %u.", page + 1, menu->pageCount);
+    menu->page  = page;
+    menu->dirty = true;
+    return true;
+}
+
 static MenuStatus
 menuPressKey(Menu* menu, KeyChord* keyChord)
 {
     assert(menu), assert(keyChord);
 
+    usagePress(&menu->usage, keyChord);
+
     if (propIsSet(keyChord, KC_PROP_GOTO))
     {
         return menuHandleGoto(menu, keyChord);
@@ -283,16 +387,19 @@ menuPressKey(Menu* menu, KeyChord* keyChord)
     return menuHandleCommands(menu, keyChord);
 }
 
-MenuStatus
-menuHandleKeypress(Menu* menu, const Key* key)
+static MenuStatus
+handleKeypress(Menu* menu, const Key* key)
 {
     assert(menu), assert(key);
 
+    /* Disassembling on every key would swamp a trace. */
+    bool debug = menu->debug && !traceIsRunning(&menu->trace);
+
     spanForEach(menu->keyChords, KeyChord, keyChord)
     {
         if (keyIsEqual(&keyChord->key, key))
         {
-            if (menu->debug)
+            if (debug)
             {
                 debugMsg(menu->debug, "Found match: '%s'.", keyChord->key.repr.data);
                 disassembleKeyChordWithHeader(keyChord, 0);
@@ -303,7 +410,9 @@ menuHandleKeypress(Menu* menu, const Key* key)
         }
     }
 
-    if (menu->debug)
+    if (menuHandlePageKey(menu, key)) return MENU_STATUS_DAMAGED;
+
+    if (debug)
     {
         debugMsg(menu->debug, "Did not find a match for keypress.");
         disassembleKey(key);
@@ -312,6 +421,18 @@ menuHandleKeypress(Menu* menu, const Key* key)
     return MENU_STATUS_EXIT_SOFTWARE;
 }
 
+MenuStatus
+menuHandleKeypress(Menu* menu, const Key* key)
+{
+    assert(menu), assert(key);
+
+    traceBegin(&menu->trace, TRACE_HANDLE);
+    MenuStatus status = handleKeypress(menu, key);
+    traceEnd(&menu->trace, TRACE_HANDLE, status);
+
+    return status;
+}
+
 MenuStatus
 menuHandlePath(Menu* menu, const char* path)
 {
@@ -446,8 +567,19 @@ menuInit(Menu* menu)
     menu->builtinKeyChords  = &builtinKeyChords;
     menu->keyChords         = &builtinKeyChords;
     menu->keyChordsHead     = &builtinKeyChords;
-    menu->cleanupfp         = NULL;
+    menu->ungrabfp          = NULL;
     menu->xp                = NULL;
+    runnerInit(&menu->runner);
+    latencyInit(&menu->latency);
+    traceInit(&menu->trace);
+    usageInit(&menu->usage);
+    menu->pipeline.steps    = VECTOR_INIT(PipelineStep);
+    menu->pipeline.next     = 0;
+    menu->pipeline.pid      = -1;
+    menu->pipeline.pidfd    = -1;
+    menu->pipeline.status   = 0;
+    menu->pipeline.exited   = false;
+    menu->pipeline.onRunner = false;
     arenaInit(&menu->arena);
 
     menu->maxCols      = maxCols;
@@ -461,34 +593,147 @@ menuInit(Menu* menu)
     menu->headerHeight = 0;
     menu->rows         = 0;
     menu->cols         = 0;
+    menu->page         = 0;
+    menu->pageCount    = 1;
     menu->width        = 0;
     menu->height       = 0;
     menu->borderWidth  = borderWidth;
     menu->delay        = delay;
     menu->keepDelay    = keepDelay;
 
-    menu->position    = (menuPosition ? MENU_POS_TOP : MENU_POS_BOTTOM);
-    menu->headerAlign = (HeaderAlign)headerAlign;
-    menu->debug       = false;
-    menu->sort        = true;
-    menu->dirty       = true;
-    menu->wrapCmd     = wrapCmd;
+    menu->renderThreads = 0;
+
+    menu->position     = (menuPosition ? MENU_POS_TOP : MENU_POS_BOTTOM);
+    menu->headerAlign  = (HeaderAlign)headerAlign;
+    menu->debug        = false;
+    menu->sort         = true;
+    menu->cache        = true;
+    menu->clientRender = false;
+    menu->useRunner    = false;
+    menu->keepPending  = false;
+    menu->dirty        = true;
+    menu->wrapCmd      = wrapCmd;
+    menu->latencyFile  = NULL;
+}
+
+static bool
+pipelineIsRunning(const Menu* menu)
+{
+    assert(menu);
+
+    return menu->pipeline.pid > 0 || menu->pipeline.onRunner;
+}
+
+static uint32_t
+remainingMs(const struct timespec* start, uint32_t ms)
+{
+    assert(start);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t elapsed =
+        (((int64_t)(now.tv_sec - start->tv_sec) * 1000000000) +
+         (now.tv_nsec - start->tv_nsec));
+    int64_t delay = (int64_t)ms * 1000000;
+
+    if (elapsed >= delay) return 0;
+
+    /* Round up so waiting out the remainder never wakes early. */
+    return (uint32_t)((delay - elapsed + 999999) / 1000000);
+}
+
+uint32_t
+menuDelayRemaining(Menu* menu)
+{
+    assert(menu);
+    if (!menu->delay) return 0;
+
+    return remainingMs(&menu->timer, menu->delay);
+}
+
+/* Returns true once the +keep deadline has passed, and clears it. A sync
+ * command that is still running may need the keyboard, so the deadline
+ * waits for it. */
+bool
+menuKeepExpired(Menu* menu)
+{
+    assert(menu);
+
+    if (!menu->keepPending || pipelineIsRunning(menu) || menuKeepRemaining(menu)) return false;
+
+    menu->keepPending = false;
+    return true;
+}
+
+uint32_t
+menuKeepRemaining(Menu* menu)
+{
+    assert(menu);
+    if (!menu->keepPending || pipelineIsRunning(menu)) return 0;
+
+    return remainingMs(&menu->keepTimer, menu->keepDelay);
+}
+
+/* The time until the menu delay or the +keep deadline, whichever is first,
+ * or 0 if neither is pending. */
+uint32_t
+menuWaitRemaining(Menu* menu)
+{
+    assert(menu);
+
+    uint32_t delay = menuDelayRemaining(menu);
+    uint32_t keep  = menuKeepRemaining(menu);
+
+    if (!delay) return keep;
+    if (!keep) return delay;
+    return delay < keep ? delay : keep;
 }
 
 bool
 menuIsDelayed(Menu* menu)
 {
     assert(menu);
-    if (!menu->delay) return false;
 
-    static struct timespec now;
-    clock_gettime(CLOCK_MONOTONIC, &now);
+    return menuDelayRemaining(menu) > 0;
+}
+
+/* Fill 'prefixes' with the prefixes of the current level pressed most in
+ * past sessions, most pressed first, and return how many there are. Chords
+ * never pressed are not guessed at. */
+size_t
+menuPredictPrefixes(Menu* menu, KeyChord* prefixes[MENU_PREFETCH_COUNT])
+{
+    assert(menu), assert(prefixes);
+
+    uint64_t counts[MENU_PREFETCH_COUNT];
+    size_t   found = 0;
+
+    spanForEach(menu->keyChords, KeyChord, keyChord)
+    {
+        if (keyChord->keyChords.count == 0 || propIsSet(keyChord, KC_PROP_GOTO)) continue;
+
+        uint64_t count = usageCount(&menu->usage, keyChord);
+        if (!count) continue;
 
-    long elapsedTime =
-        (((now.tv_sec - menu->timer.tv_sec) * 1000) +
-         ((now.tv_nsec - menu->timer.tv_nsec) / 1000000));
+        size_t i = found < MENU_PREFETCH_COUNT ? found++ : MENU_PREFETCH_COUNT;
+        while (i > 0 && counts[i - 1] < count)
+        {
+            if (i < MENU_PREFETCH_COUNT)
+            {
+                counts[i]   = counts[i - 1];
+                prefixes[i] = prefixes[i - 1];
+            }
+            i--;
+        }
+        if (i < MENU_PREFETCH_COUNT)
+        {
+            counts[i]   = count;
+            prefixes[i] = keyChord;
+        }
+    }
 
-    return elapsedTime < menu->delay;
+    return found;
 }
 
 static void
@@ -505,11 +750,25 @@ usage(void)
         "                               startup/last keypress (default 1000 ms).\n"
         "    --keep-delay INT           Delay in milliseconds after ungrab before command\n"
         "                               execution for +keep chords (default 75 ms).\n"
+        "    --render-threads INT       Draw full frames on INT threads, one column tile\n"
+        "                               each. 0 or 1 draws on the main thread (default 0).\n"
         "    -t, --top                  Position menu at top of screen.\n"
         "    -b, --bottom               Position menu at bottom of screen.\n"
         "    -c, --center               Position menu at center of screen.\n"
         "    -s, --script               Read script from stdin to use as key chords.\n"
         "    -U, --unsorted             Disable sorting of key chords (sorted by default).\n"
+        "    --no-cache                 Disable caching of rendered menu cells and\n"
+        "                               background, border, and title.\n"
+        "    --client-render            Draw X11 frames in client memory and upload them\n"
+        "                               with MIT-SHM, or XPutImage when unavailable.\n"
+        "    --runner                   Start a helper process before showing the menu\n"
+        "                               and run commands through it.\n"
+        "    --latency FILE             Write a histogram of key-to-frame latency to FILE\n"
+        "                               on exit, or to stderr if FILE is '-'.\n"
+        "    --trace FILE               Record a trace of keys, frames, and commands and\n"
+        "                               write it to FILE on exit or SIGUSR1.\n"
+        "    --prefetch                 Count chord presses and draw the most used\n"
+        "                               prefixes ahead of time while idle.\n"
         "    -m, --max-columns INT      Set the maximum menu columns to INT (defualt 5).\n"
         "    -p, --press KEY(s)         Press KEY(s) before dispalying menu.\n"
         "    -T, --transpile FILE       Transpile FILE to valid 'key_chords.h' syntax and\n"
@@ -606,6 +865,10 @@ menuParseArgs(Menu* menu, int* argc, char*** argv)
         { "center",        no_argument,       0, 'c'                   },
         { "script",        no_argument,       0, 's'                   },
         { "unsorted",      no_argument,       0, 'U'                   },
+        { "no-cache",      no_argument,       0, OPT_ARG_NO_CACHE      },
+        { "client-render", no_argument,       0, OPT_ARG_CLIENT_RENDER },
+        { "runner",        no_argument,       0, OPT_ARG_RUNNER        },
+        { "prefetch",      no_argument,       0, OPT_ARG_PREFETCH      },
         /*                  required argument           */
         { "delay",         required_argument, 0, 'D'                   },
         { "max-columns",   required_argument, 0, 'm'                   },
@@ -638,7 +901,10 @@ menuParseArgs(Menu* menu, int* argc, char*** argv)
         { "keep-delay",    required_argument, 0, OPT_ARG_KEEP_DELAY    },
         { "header-align",  required_argument, 0, OPT_ARG_HEADER_ALIGN  },
         { "header-font",   required_argument, 0, OPT_ARG_HEADER_FONT   },
-        { 0,               0,                 0, 0                     }
+        { "render-threads", required_argument, 0, OPT_ARG_RENDER_THREADS },
+        { "latency",       required_argument, 0, OPT_ARG_LATENCY       },
+        { "trace",         required_argument, 0, OPT_ARG_TRACE         },
+        { 0,                0,                 0, 0                      }
     };
 
     /* Don't let 'getopt' print errors. */
@@ -661,6 +927,10 @@ menuParseArgs(Menu* menu, int* argc, char*** argv)
         case 'c': menu->position = MENU_POS_CENTER; break;
         case 's': menu->client.tryScript = true; break;
         case 'U': menu->sort = false; break;
+        case OPT_ARG_NO_CACHE: menu->cache = false; break;
+        case OPT_ARG_CLIENT_RENDER: menu->clientRender = true; break;
+        case OPT_ARG_RUNNER: menu->useRunner = true; break;
+        case OPT_ARG_PREFETCH: menu->usage.enabled = true; break;
         /* requires argument */
         case 'D':
         {
@@ -824,6 +1094,25 @@ menuParseArgs(Menu* menu, int* argc, char*** argv)
             break;
         }
         case OPT_ARG_HEADER_FONT: menu->headerFont = optarg; break;
+        case OPT_ARG_LATENCY:
+        {
+            menu->latencyFile     = optarg;
+            menu->latency.enabled = true;
+            break;
+        }
+        case OPT_ARG_TRACE: menu->trace.path = optarg; break;
+        case OPT_ARG_RENDER_THREADS:
+        {
+            int n = 0;
+            if (!getInt(&n) || n < 0)
+            {
+                warnMsg("Could not convert '%s' into a non-negative integer.", optarg);
+                warnMsg("Using default value for render-threads: %u.", menu->renderThreads);
+                break;
+            }
+            menu->renderThreads = (uint32_t)n;
+            break;
+        }
         /* Errors */
         case '?':
         {
@@ -886,94 +1175,233 @@ menuSetWrapCmd(Menu* menu, const char* cmd)
     menu->wrapCmd = cmd;
 }
 
-static MenuStatus
-spawnSync(const char* shell, const char* cmd)
+/* Collect async commands that have already finished. The running sync
+ * step may be among them, its status is kept for pipelineReap. */
+static void
+reapChildren(Menu* menu)
 {
-    assert(shell), assert(cmd);
+    assert(menu);
 
-    setsid();
-    char* exec[] = { strdup(shell), "-c", strdup(cmd), NULL, NULL };
-    if (!exec[0])
-    {
-        errorMsg("Could not duplicate shell string: '%s'.", shell);
-        goto fail;
-    }
-    if (!exec[2])
+    struct Pipeline* pipeline = &menu->pipeline;
+    pid_t            pid;
+    int              status;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
     {
-        errorMsg("Could not duplicate command string: '%s'.", cmd);
-        goto fail;
+        if (pid != pipeline->pid) continue;
+        pipeline->status = status;
+        pipeline->exited = true;
     }
-    execvp(exec[0], exec);
-    errorMsg("Failed to spawn command: '%s -c %s'.", shell, cmd);
-
-fail:
-    free(exec[0]);
-    free(exec[2]);
-    return MENU_STATUS_EXIT_SOFTWARE;
 }
 
-static MenuStatus
-spawnAsync(const char* shell, const char* cmd)
+/* Start a command. 'child' is the process to wait for, or -1 when the runner
+ * took it. */
+static bool
+spawnCommand(Menu* menu, Command* command, bool sync, pid_t* child)
 {
-    assert(shell), assert(cmd);
+    assert(menu), assert(command), assert(child);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    const char* file        = menu->shell;
+    char*       shellArgv[] = { (char*)menu->shell, "-c", (char*)command->line.data, NULL };
+    char**      argv        = shellArgv;
 
-    if (fork() == 0)
+    *child = -1;
+
+    if (command->kind == COMMAND_DIRECT && commandResolvePath(command, &menu->arena))
     {
-        spawnSync(shell, cmd);
+        file = command->path;
+        argv = command->argv;
     }
-    return MENU_STATUS_EXIT_OK;
+
+    /* A sync command on the runner is waited for like a child, through the
+     * runner's socket instead of a pidfd. */
+    if (runnerRun(&menu->runner, file, argv, sync))
+    {
+        debugMsg(
+            menu->debug,
+            "Queued '%s' (%s) on the runner in %.2f ms.",
+            command->line.data,
+            commandKindRepr(command->kind),
+            elapsedMs(&start));
+        return true;
+    }
+
+    int err = commandSpawn(file, argv, child);
+    if (err)
+    {
+        errorMsg("Failed to spawn command: '%s': %s.", command->line.data, strerror(err));
+        *child = -1;
+        return false;
+    }
+
+    debugMsg(
+        menu->debug,
+        "Spawned '%s' (%s) in %.2f ms.",
+        command->line.data,
+        commandKindRepr(command->kind),
+        elapsedMs(&start));
+    return true;
 }
 
-MenuStatus
-menuSpawn(const Menu* menu, const KeyChord* keyChord, const String* cmd, bool sync)
+static int
+pidfdOpen(pid_t pid)
 {
-    assert(menu);
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    return -1;
+#endif
+}
 
-    if (stringIsEmpty(cmd)) return MENU_STATUS_EXIT_OK;
+/* Wait for the running sync step, or only check on it when 'options' is
+ * WNOHANG. Returns true once it is gone. */
+static bool
+pipelineReap(Menu* menu, int options)
+{
+    assert(menu);
 
-    pid_t child = fork();
+    struct Pipeline* pipeline = &menu->pipeline;
+    if (!pipelineIsRunning(menu)) return true;
 
-    if (child == -1)
+    if (pipeline->onRunner)
     {
-        errorMsg("Could not fork process:");
-        perror(NULL);
-        return MENU_STATUS_EXIT_SOFTWARE;
+        if (!runnerReadStatus(&menu->runner, &pipeline->status, options != WNOHANG)) return false;
+        if (pipeline->status == -1) debugMsg(menu->debug, "Runner could not run a sync command.");
+    }
+    else if (!pipeline->exited)
+    {
+        pid_t pid = waitpid(pipeline->pid, &pipeline->status, options);
+        if (pid == 0 || (pid < 0 && errno == EINTR)) return false;
+        if (pid < 0) pipeline->status = -1;
     }
 
-    if (child == 0)
+    if (pipeline->status != -1 && WIFEXITED(pipeline->status))
     {
-        if (menu->xp && menu->cleanupfp) menu->cleanupfp(menu->xp);
+        debugMsg(menu->debug, "Sync command exited with %d.", WEXITSTATUS(pipeline->status));
+    }
+
+    if (pipeline->pidfd >= 0) close(pipeline->pidfd);
+    pipeline->pid      = -1;
+    pipeline->pidfd    = -1;
+    pipeline->exited   = false;
+    pipeline->onRunner = false;
+    return true;
+}
+
+/* Start queued steps until one is sync. Its pidfd, or the runner's socket,
+ * is then watched by the backend's event loop, which calls
+ * menuContinueCommands once it is done. */
+static void
+pipelineAdvance(Menu* menu)
+{
+    assert(menu);
 
-        if (cmd->length == 0) exit(EX_OK);
+    struct Pipeline* pipeline = &menu->pipeline;
+    while (!pipelineIsRunning(menu) && pipeline->next < vectorLength(&pipeline->steps))
+    {
+        PipelineStep* step = VECTOR_GET(&pipeline->steps, PipelineStep, pipeline->next++);
+        pid_t         child;
 
-        if (sync)
+        /* Flushed right away, so the text comes out in pipeline order and
+         * not whenever stdout is next flushed. */
+        if (step->write)
         {
-            spawnSync(menu->shell, cmd->data);
+            printf("%s\n", step->write->data);
+            fflush(stdout);
+            continue;
         }
-        else
+
+        traceBegin(&menu->trace, TRACE_SPAWN);
+        bool spawned = spawnCommand(menu, step->command, step->sync, &child);
+        traceEnd(&menu->trace, TRACE_SPAWN, step->command->kind);
+
+        if (!spawned || !step->sync) continue;
+        if (child < 0)
         {
-            spawnAsync(menu->shell, cmd->data);
+            pipeline->onRunner = true;
+            continue;
         }
-        exit(EX_OK);
+
+        pipeline->pid   = child;
+        pipeline->pidfd = pidfdOpen(child);
+
+        /* Without pidfds there is nothing to watch, wait here as before. */
+        if (pipeline->pidfd < 0) pipelineReap(menu, 0);
     }
 
-    if (sync)
+    if (!pipelineIsRunning(menu))
     {
-        int status;
-        if (waitpid(child, &status, 0) == -1)
-        {
-            errorMsg("Could not wait for child process:");
-            perror(NULL);
-            return MENU_STATUS_EXIT_SOFTWARE;
-        }
+        vectorClear(&pipeline->steps);
+        pipeline->next = 0;
+    }
 
-        return WIFEXITED(status) ? MENU_STATUS_EXIT_OK : MENU_STATUS_EXIT_SOFTWARE;
+    reapChildren(menu);
+}
+
+int
+menuCommandFd(const Menu* menu)
+{
+    assert(menu);
+
+    if (menu->pipeline.onRunner) return menu->runner.fd;
+    return menu->pipeline.pidfd;
+}
+
+void
+menuContinueCommands(Menu* menu)
+{
+    assert(menu);
+
+    if (!pipelineIsRunning(menu) || !pipelineReap(menu, WNOHANG)) return;
+
+    pipelineAdvance(menu);
+
+    /* The +keep deadline was held while the step ran, it starts over once
+     * nothing is left to wait for. */
+    if (menu->keepPending && !pipelineIsRunning(menu)) clock_gettime(CLOCK_MONOTONIC, &menu->keepTimer);
+}
+
+/* Run whatever is still queued once the menu is gone. */
+void
+menuFinishCommands(Menu* menu)
+{
+    assert(menu);
+
+    while (pipelineIsRunning(menu))
+    {
+        while (!pipelineReap(menu, 0));
+        pipelineAdvance(menu);
     }
+}
+
+/* Queue a command behind any sync command that is still running. */
+MenuStatus
+menuSpawn(Menu* menu, Command* command, bool sync)
+{
+    assert(menu), assert(command), assert(command->kind != COMMAND_UNCLASSIFIED);
 
-    wait(NULL);
+    if (command->kind == COMMAND_EMPTY) return MENU_STATUS_EXIT_OK;
+
+    PipelineStep step = { .command = command, .sync = sync };
+    vectorAppend(&menu->pipeline.steps, &step);
+    pipelineAdvance(menu);
     return MENU_STATUS_EXIT_OK;
 }
 
+/* Queue the text of a +write chord behind any sync command that is still
+ * running. */
+void
+menuWrite(Menu* menu, const String* text)
+{
+    assert(menu), assert(text);
+
+    PipelineStep step = { .write = text };
+    vectorAppend(&menu->pipeline.steps, &step);
+    pipelineAdvance(menu);
+}
+
 bool
 menuStatusIsError(MenuStatus status)
 {
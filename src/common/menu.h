@@ -5,13 +5,28 @@
 #include <time.h>
 
 #include "common/arena.h"
+#include "common/latency.h"
+#include "common/runner.h"
 #include "common/span.h"
+#include "common/trace.h"
+#include "common/usage.h"
 #include "common/vector.h"
 #include "key_chord.h"
 
 #define MENU_MIN_WIDTH 80
+#define MENU_PREFETCH_COUNT 2
 
-typedef void (*CleanupFP)(void* xp);
+typedef void (*UngrabFP)(void* xp);
+
+/* A command waiting to run, or the text of a +write chord waiting to be
+ * printed. Steps run in order, but only a sync step holds back the ones
+ * after it. */
+typedef struct
+{
+    Command*      command;
+    const String* write;
+    bool          sync;
+} PipelineStep;
 
 typedef uint8_t ForegroundColor;
 enum
@@ -102,7 +117,8 @@ typedef struct
         bool        tryScript;
     } client;
     struct timespec timer;
-    CleanupFP       cleanupfp;
+    struct timespec keepTimer;
+    UngrabFP        ungrabfp;
     Vector          userVars;
     Span            compiledKeyChords;
     Span*           builtinKeyChords;
@@ -110,6 +126,20 @@ typedef struct
     Span*           keyChordsHead;
     void*           xp;
     Arena           arena;
+    Runner          runner;
+    Latency         latency;
+    Trace           trace;
+    Usage           usage;
+    struct Pipeline
+    {
+        Vector steps;
+        size_t next;
+        pid_t  pid;
+        int    pidfd;
+        int    status;
+        bool   exited;
+        bool   onRunner;
+    } pipeline;
 
     uint32_t    maxCols;
     int32_t     menuWidth;
@@ -122,33 +152,51 @@ typedef struct
     uint32_t    headerHeight;
     uint32_t    rows;
     uint32_t    cols;
+    uint32_t    page;
+    uint32_t    pageCount;
     uint32_t    width;
     uint32_t    height;
     uint32_t    borderWidth;
     uint32_t    delay;
     uint32_t    keepDelay;
+    uint32_t    renderThreads;
     const char* wrapCmd;
+    const char* latencyFile;
 
     MenuPosition position;
     HeaderAlign  headerAlign;
     bool         debug;
     bool         sort;
+    bool         cache;
+    bool         clientRender;
+    bool         useRunner;
+    bool         keepPending;
     bool         dirty;
 } Menu;
 
+void       menuClassifyCommands(Menu* menu, KeyChord* keyChord);
+int        menuCommandFd(const Menu* menu);
+void       menuContinueCommands(Menu* menu);
+uint32_t   menuDelayRemaining(Menu* menu);
 int        menuDisplay(Menu* menu);
+void       menuFinishCommands(Menu* menu);
 void       menuFree(Menu* menu);
 MenuStatus menuHandleKeypress(Menu* menu, const Key* key);
 MenuStatus menuHandlePath(Menu* menu, const char* path);
 void       menuInit(Menu* menu);
 bool       menuIsDelayed(Menu* menu);
+bool       menuKeepExpired(Menu* menu);
+uint32_t   menuKeepRemaining(Menu* menu);
 void       menuParseArgs(Menu* menu, int* argc, char*** argv);
+size_t     menuPredictPrefixes(Menu* menu, KeyChord* prefixes[MENU_PREFETCH_COUNT]);
 void       menuResetTimer(Menu* menu);
 void       menuSetColor(Menu* menu, const char* color, MenuColor colorType);
 void       menuSetWrapCmd(Menu* menu, const char* cmd);
-MenuStatus menuSpawn(const Menu* menu, const KeyChord* keyChord, const String* cmd, bool sync);
+MenuStatus menuSpawn(Menu* menu, Command* command, bool sync);
 bool       menuStatusIsError(MenuStatus status);
 bool       menuStatusIsRunning(MenuStatus status);
 bool       menuTryStdin(Menu* menu);
+uint32_t   menuWaitRemaining(Menu* menu);
+void       menuWrite(Menu* menu, const String* text);
 
 #endif /* WK_COMMON_MENU_H_ */
@@ -0,0 +1,224 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+/* local includes */
+#include "command.h"
+#include "common.h"
+#include "runner.h"
+
+/* A request is the header followed by the program and its arguments, each
+ * NUL-terminated. A reply is the 'int' wait status of a sync request, or -1
+ * when the program could not be started. */
+typedef struct
+{
+    uint32_t sync;
+    uint32_t argc;
+} RunnerHeader;
+
+static void
+reapChildren(void)
+{
+    while (waitpid(-1, NULL, WNOHANG) > 0);
+}
+
+/* Split a request in place. Returns the program, or NULL if the request is
+ * malformed. */
+static const char*
+parseRequest(char* buffer, size_t length, RunnerHeader* header, char** argv, size_t maxArgs)
+{
+    assert(buffer), assert(header), assert(argv);
+
+    if (length <= sizeof(RunnerHeader) || buffer[length - 1] != '\0') return NULL;
+
+    memcpy(header, buffer, sizeof(RunnerHeader));
+    if (header->argc == 0 || header->argc >= maxArgs) return NULL;
+
+    char*       p    = buffer + sizeof(RunnerHeader);
+    char*       end  = buffer + length;
+    const char* file = p;
+
+    p += strlen(p) + 1;
+    for (uint32_t i = 0; i < header->argc; i++)
+    {
+        if (p >= end) return NULL;
+        argv[i] = p;
+        p += strlen(p) + 1;
+    }
+    argv[header->argc] = NULL;
+
+    return file;
+}
+
+static void
+runnerMain(int fd)
+{
+    static char  buffer[RUNNER_MESSAGE_MAX];
+    static char* argv[RUNNER_MESSAGE_MAX / 2];
+
+    /* Outlive the menu, commands queued right before it exits still run. */
+    setsid();
+
+    while (true)
+    {
+        ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) break;
+
+        RunnerHeader header;
+        const char*  file = parseRequest(buffer, length, &header, argv, sizeof(argv) / sizeof(argv[0]));
+        if (!file) continue;
+
+        pid_t pid;
+        int   status = -1;
+        if (commandSpawn(file, argv, &pid) == 0 && header.sync)
+        {
+            while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+        }
+
+        /* The menu reads each status before it sends more work, so this never
+         * waits. If it stopped reading, the status is dropped. */
+        reapChildren();
+        if (header.sync) send(fd, &status, sizeof(status), MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+
+    _exit(EX_OK);
+}
+
+void
+runnerInit(Runner* runner)
+{
+    assert(runner);
+
+    runner->pid = -1;
+    runner->fd  = -1;
+}
+
+bool
+runnerIsRunning(const Runner* runner)
+{
+    assert(runner);
+
+    return runner->fd >= 0;
+}
+
+/* Read the exit status of the sync command the runner was last sent. Unless
+ * 'wait' is set, returns false if it has not finished yet. A runner that is
+ * gone reports a status of -1. */
+bool
+runnerReadStatus(Runner* runner, int* status, bool wait)
+{
+    assert(runner), assert(status);
+
+    *status = -1;
+    if (!runnerIsRunning(runner)) return true;
+
+    ssize_t length;
+    while ((length = recv(runner->fd, status, sizeof(*status), wait ? 0 : MSG_DONTWAIT)) < 0 && errno == EINTR);
+    if (length == sizeof(*status)) return true;
+    if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+
+    errorMsg("Lost the command runner, spawning commands directly.");
+    runnerStop(runner);
+    *status = -1;
+    return true;
+}
+
+/* Queue a program on the runner. Returns false if it could not be sent, the
+ * caller spawns it itself then. */
+bool
+runnerRun(Runner* runner, const char* file, char* const argv[], bool sync)
+{
+    assert(runner), assert(file), assert(argv);
+
+    if (!runnerIsRunning(runner)) return false;
+
+    RunnerHeader header = { .sync = sync, .argc = 0 };
+    size_t       length = sizeof(RunnerHeader) + strlen(file) + 1;
+    for (; argv[header.argc]; header.argc++)
+    {
+        length += strlen(argv[header.argc]) + 1;
+    }
+
+    if (length > RUNNER_MESSAGE_MAX) return false;
+
+    char* buffer = malloc(length);
+    if (!buffer) return false;
+
+    char* p = buffer;
+    memcpy(p, &header, sizeof(RunnerHeader));
+    p += sizeof(RunnerHeader);
+    memcpy(p, file, strlen(file) + 1);
+    p += strlen(file) + 1;
+    for (uint32_t i = 0; i < header.argc; i++)
+    {
+        size_t argLength = strlen(argv[i]) + 1;
+        memcpy(p, argv[i], argLength);
+        p += argLength;
+    }
+
+    ssize_t sent;
+    while ((sent = send(runner->fd, buffer, length, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+    free(buffer);
+
+    if (sent == (ssize_t)length) return true;
+
+    errorMsg("Lost the command runner, spawning commands directly.");
+    runnerStop(runner);
+    return false;
+}
+
+/* Fork the runner. Call this before the display and fonts are loaded so the
+ * runner's address space stays small. */
+bool
+runnerStart(Runner* runner)
+{
+    assert(runner);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0)
+    {
+        errorMsg("Could not create the command runner socket: %s.", strerror(errno));
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        errorMsg("Could not fork the command runner: %s.", strerror(errno));
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0)
+    {
+        close(fds[0]);
+        runnerMain(fds[1]);
+    }
+
+    close(fds[1]);
+    runner->pid = pid;
+    runner->fd  = fds[0];
+    return true;
+}
+
+/* Closing the socket lets the runner finish what is queued and exit. Only
+ * async commands can be left by then, so reaping it does not wait long. */
+void
+runnerStop(Runner* runner)
+{
+    assert(runner);
+
+    if (runner->fd >= 0) close(runner->fd);
+    if (runner->pid > 0) while (waitpid(runner->pid, NULL, 0) < 0 && errno == EINTR);
+    runnerInit(runner);
+}
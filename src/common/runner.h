@@ -0,0 +1,25 @@
+#ifndef WK_COMMON_RUNNER_H_
+#define WK_COMMON_RUNNER_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define RUNNER_MESSAGE_MAX (1 << 16)
+
+/* A helper process forked before the display is opened. It spawns the
+ * commands it is sent one after another and sends back the exit status of
+ * sync ones, which the menu waits for before sending the next. */
+typedef struct
+{
+    pid_t pid;
+    int   fd;
+} Runner;
+
+void runnerInit(Runner* runner);
+bool runnerIsRunning(const Runner* runner);
+bool runnerReadStatus(Runner* runner, int* status, bool wait);
+bool runnerRun(Runner* runner, const char* file, char* const argv[], bool sync);
+bool runnerStart(Runner* runner);
+void runnerStop(Runner* runner);
+
+#endif /* WK_COMMON_RUNNER_H_ */
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* local includes */
+#include "common.h"
+#include "trace.h"
+
+static const char* traceNames[TRACE_NAME_COUNT] = {
+    [TRACE_KEY]          = "key",
+    [TRACE_HANDLE]       = "handle",
+    [TRACE_RENDER]       = "render",
+    [TRACE_PAINT]        = "paint",
+    [TRACE_SPAWN]        = "spawn",
+    [TRACE_WAIT]         = "wait",
+    [TRACE_PREFETCH]     = "prefetch",
+    [TRACE_START]        = "start",
+    [TRACE_INPUT_METHOD] = "input-method",
+};
+
+static const char tracePhases[] = {
+    [TRACE_PHASE_BEGIN]   = 'B',
+    [TRACE_PHASE_END]     = 'E',
+    [TRACE_PHASE_INSTANT] = 'i',
+};
+
+static volatile sig_atomic_t dumpRequested = 0;
+
+static void
+requestDump(int signal)
+{
+    (void)signal;
+    dumpRequested = 1;
+}
+
+/* SIGUSR1 only sets a flag. The event loops wake up from it and call this
+ * at the top of each iteration to write the ring out. */
+void
+traceCheckDump(Trace* trace)
+{
+    assert(trace);
+
+    if (!dumpRequested) return;
+
+    dumpRequested = 0;
+    traceWrite(trace);
+}
+
+void
+traceFree(Trace* trace)
+{
+    assert(trace);
+
+    free(trace->events);
+    trace->events = NULL;
+    trace->head   = 0;
+}
+
+void
+traceInit(Trace* trace)
+{
+    assert(trace);
+
+    trace->events = NULL;
+    trace->head   = 0;
+    trace->path   = NULL;
+}
+
+bool
+traceStart(Trace* trace)
+{
+    assert(trace), assert(trace->path);
+
+    trace->events = calloc(TRACE_CAPACITY, sizeof(TraceEvent));
+    if (!trace->events)
+    {
+        errorMsg("Could not allocate the trace buffer.");
+        return false;
+    }
+
+    /* No SA_RESTART, the signal has to interrupt the event loop's wait. */
+    struct sigaction action = { 0 };
+    action.sa_handler       = requestDump;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+
+    /* Startup is measured from here, before the backend connects. */
+    traceInstant(trace, TRACE_START, 0);
+    return true;
+}
+
+/* Write the ring as Chrome trace event JSON, which Perfetto and
+ * chrome://tracing open directly. */
+bool
+traceWrite(const Trace* trace)
+{
+    assert(trace);
+
+    if (!traceIsRunning(trace)) return false;
+
+    FILE* file = fopen(trace->path, "w");
+    if (!file)
+    {
+        errorMsg("Could not open '%s' for the trace: %s.", trace->path, strerror(errno));
+        return false;
+    }
+
+    uint64_t first = trace->head > TRACE_CAPACITY ? trace->head - TRACE_CAPACITY : 0;
+    int      pid   = (int)getpid();
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    for (uint64_t i = first; i < trace->head; i++)
+    {
+        const TraceEvent* event = &trace->events[i & (TRACE_CAPACITY - 1)];
+        fprintf(
+            file,
+            "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":%d,\"tid\":%d,\"args\":{\"arg\":%u}%s}%s\n",
+            traceNames[event->name],
+            tracePhases[event->phase],
+            (unsigned long long)(event->ns / 1000),
+            (unsigned)(event->ns % 1000),
+            pid,
+            pid,
+            event->arg,
+            event->phase == TRACE_PHASE_INSTANT ? ",\"s\":\"t\"" : "",
+            i + 1 < trace->head ? "," : "");
+    }
+    fputs("]}\n", file);
+
+    return fclose(file) == 0;
+}
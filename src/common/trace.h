@@ -0,0 +1,95 @@
+#ifndef WK_COMMON_TRACE_H_
+#define WK_COMMON_TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Must be a power of two. */
+#define TRACE_CAPACITY (1 << 15)
+
+typedef enum
+{
+    TRACE_KEY,
+    TRACE_HANDLE,
+    TRACE_RENDER,
+    TRACE_PAINT,
+    TRACE_SPAWN,
+    TRACE_WAIT,
+    TRACE_PREFETCH,
+    TRACE_START,
+    TRACE_INPUT_METHOD,
+    TRACE_NAME_COUNT,
+} TraceName;
+
+typedef enum
+{
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    TRACE_PHASE_INSTANT,
+} TracePhase;
+
+typedef struct
+{
+    uint64_t ns;
+    uint32_t arg;
+    uint8_t  name;
+    uint8_t  phase;
+} TraceEvent;
+
+/* A ring of the last TRACE_CAPACITY events, recorded without formatting
+ * anything so tracing barely moves the timings it shows. The ring is only
+ * allocated when tracing was asked for. */
+typedef struct
+{
+    TraceEvent* events;
+    uint64_t    head;
+    const char* path;
+} Trace;
+
+static inline bool
+traceIsRunning(const Trace* trace)
+{
+    return trace->events != NULL;
+}
+
+static inline void
+traceRecord(Trace* trace, TraceName name, TracePhase phase, uint32_t arg)
+{
+    if (!trace->events) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    TraceEvent* event = &trace->events[trace->head++ & (TRACE_CAPACITY - 1)];
+    event->ns         = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+    event->arg        = arg;
+    event->name       = name;
+    event->phase      = phase;
+}
+
+static inline void
+traceBegin(Trace* trace, TraceName name)
+{
+    traceRecord(trace, name, TRACE_PHASE_BEGIN, 0);
+}
+
+static inline void
+traceEnd(Trace* trace, TraceName name, uint32_t arg)
+{
+    traceRecord(trace, name, TRACE_PHASE_END, arg);
+}
+
+static inline void
+traceInstant(Trace* trace, TraceName name, uint32_t arg)
+{
+    traceRecord(trace, name, TRACE_PHASE_INSTANT, arg);
+}
+
+void traceCheckDump(Trace* trace);
+void traceFree(Trace* trace);
+void traceInit(Trace* trace);
+bool traceStart(Trace* trace);
+bool traceWrite(const Trace* trace);
+
+#endif /* WK_COMMON_TRACE_H_ */
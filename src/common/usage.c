@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* local includes */
+#include "common.h"
+#include "key_chord.h"
+#include "span.h"
+#include "usage.h"
+
+#define USAGE_MAGIC 0x3130656761737577ULL /* "wusage01" */
+
+/* A chord is known by its key and the keys leading to it, so counts survive
+ * edits to descriptions and commands. */
+static uint64_t
+hashPath(uint64_t parent, const KeyChord* keyChord)
+{
+    assert(keyChord);
+
+    const Key* key  = &keyChord->key;
+    uint64_t   hash = hashBytes(parent, &key->mods, sizeof(key->mods));
+    hash            = hashBytes(hash, key->repr.data, key->repr.length);
+    return hash ? hash : 1;
+}
+
+/* Hash the shape of the chord tree. Adding, removing, or rebinding keys
+ * starts a new profile. */
+static uint64_t
+hashConfig(uint64_t hash, const Span* keyChords)
+{
+    assert(keyChords);
+
+    spanForEach(keyChords, const KeyChord, keyChord)
+    {
+        hash = hashPath(hash, keyChord);
+        hash = hashBytes(hash, &keyChord->keyChords.count, sizeof(keyChord->keyChords.count));
+        hash = hashConfig(hash, &keyChord->keyChords);
+    }
+
+    return hash;
+}
+
+static UsageSlot*
+findSlot(UsageFile* file, uint64_t path, bool claim)
+{
+    assert(file);
+
+    for (size_t i = 0; i < USAGE_SLOT_COUNT; i++)
+    {
+        UsageSlot* slot = &file->slots[(path + i) & (USAGE_SLOT_COUNT - 1)];
+        if (slot->path == path) return slot;
+        if (slot->path != 0) continue;
+        if (!claim) return NULL;
+
+        slot->path = path;
+        return slot;
+    }
+
+    return NULL;
+}
+
+static bool
+makeDirectory(const char* path)
+{
+    assert(path);
+
+    return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+/* $XDG_CACHE_HOME/wk, or ~/.cache/wk, created as needed. */
+static bool
+usageDirectory(char* buffer, size_t size)
+{
+    assert(buffer);
+
+    const char* cache = getenv("XDG_CACHE_HOME");
+    const char* home  = getenv("HOME");
+    int         n     = 0;
+
+    if (cache && cache[0] == '/')
+    {
+        n = snprintf(buffer, size, "%s", cache);
+    }
+    else if (home && home[0])
+    {
+        n = snprintf(buffer, size, "%s/.cache", home);
+    }
+    else
+    {
+        return false;
+    }
+    if (n < 0 || (size_t)n >= size || !makeDirectory(buffer)) return false;
+
+    size_t length = (size_t)n;
+    n             = snprintf(buffer + length, size - length, "/wk");
+    if (n < 0 || length + n >= size) return false;
+
+    return makeDirectory(buffer);
+}
+
+void
+usageClose(Usage* usage)
+{
+    assert(usage);
+
+    if (usage->file) munmap(usage->file, sizeof(UsageFile));
+    usage->file = NULL;
+}
+
+uint64_t
+usageCount(const Usage* usage, const KeyChord* keyChord)
+{
+    assert(usage), assert(keyChord);
+
+    if (!usage->file) return 0;
+
+    const UsageSlot* slot = findSlot(usage->file, hashPath(usage->level, keyChord), false);
+    return slot ? slot->count : 0;
+}
+
+void
+usageInit(Usage* usage)
+{
+    assert(usage);
+
+    usage->file    = NULL;
+    usage->level   = FNV_OFFSET_BASIS;
+    usage->enabled = false;
+}
+
+bool
+usageOpen(Usage* usage, const Span* keyChords)
+{
+    assert(usage), assert(keyChords);
+
+    if (!usage->enabled || usage->file) return false;
+
+    char directory[4096];
+    if (!usageDirectory(directory, sizeof(directory)))
+    {
+        warnMsg("Could not find or create a cache directory for usage counts.");
+        return false;
+    }
+
+    uint64_t configHash = hashConfig(FNV_OFFSET_BASIS, keyChords);
+    char     path[4096 + 32];
+    snprintf(path, sizeof(path), "%s/usage-%016llx", directory, (unsigned long long)configHash);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        warnMsg("Could not open '%s': %s.", path, strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (st.st_size != sizeof(UsageFile) && ftruncate(fd, sizeof(UsageFile)) < 0))
+    {
+        warnMsg("Could not size '%s': %s.", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(NULL, sizeof(UsageFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        warnMsg("Could not map '%s': %s.", path, strerror(errno));
+        return false;
+    }
+
+    /* A new, truncated, or foreign file starts over. */
+    usage->file = map;
+    if (usage->file->magic != USAGE_MAGIC || usage->file->configHash != configHash)
+    {
+        memset(usage->file, 0, sizeof(UsageFile));
+        usage->file->magic      = USAGE_MAGIC;
+        usage->file->configHash = configHash;
+    }
+
+    return true;
+}
+
+/* Count a press of 'keyChord' in the current level, and descend into it if
+ * it is a prefix. The level is followed even before the file is open, so
+ * keys pressed with --press land in the right place. Two menus pressing at
+ * once may lose a count, which a profile can live with. */
+void
+usagePress(Usage* usage, const KeyChord* keyChord)
+{
+    assert(usage), assert(keyChord);
+
+    if (!usage->enabled) return;
+
+    uint64_t path = hashPath(usage->level, keyChord);
+    if (usage->file)
+    {
+        UsageSlot* slot = findSlot(usage->file, path, true);
+        if (slot) slot->count++;
+    }
+
+    if (keyChord->keyChords.count != 0) usage->level = path;
+}
+
+void
+usageReset(Usage* usage)
+{
+    assert(usage);
+
+    usage->level = FNV_OFFSET_BASIS;
+}
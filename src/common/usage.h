@@ -0,0 +1,46 @@
+#ifndef WK_COMMON_USAGE_H_
+#define WK_COMMON_USAGE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/span.h"
+#include "key_chord.h"
+
+/* Must be a power of two. */
+#define USAGE_SLOT_COUNT 2048
+
+typedef struct
+{
+    uint64_t path;
+    uint64_t count;
+} UsageSlot;
+
+/* The file layout. A table of press counts keyed by the hash of the keys
+ * leading to a chord, probed linearly. Path 0 marks a free slot. */
+typedef struct
+{
+    uint64_t  magic;
+    uint64_t  configHash;
+    UsageSlot slots[USAGE_SLOT_COUNT];
+} UsageFile;
+
+/* How often each chord of one config has been pressed, over all sessions.
+ * The counts live in a small file under the cache directory mapped shared,
+ * so a press costs one increment and nothing is written out on exit. */
+typedef struct
+{
+    UsageFile* file;
+    uint64_t   level;
+    bool       enabled;
+} Usage;
+
+void     usageClose(Usage* usage);
+uint64_t usageCount(const Usage* usage, const KeyChord* keyChord);
+void     usageInit(Usage* usage);
+bool     usageOpen(Usage* usage, const Span* keyChords);
+void     usagePress(Usage* usage, const KeyChord* keyChord);
+void     usageReset(Usage* usage);
+
+#endif /* WK_COMMON_USAGE_H_ */
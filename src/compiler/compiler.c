@@ -84,6 +84,20 @@ compilerFreeChordVector(Vector* vec)
     vectorFree(vec);
 }
 
+/* Classify commands once the chords are final so simple ones can be exec'ed
+ * without a shell. */
+static void
+classifyCommands(Menu* menu, Span* keyChords)
+{
+    assert(menu), assert(keyChords);
+
+    spanForEach(keyChords, KeyChord, keyChord)
+    {
+        menuClassifyCommands(menu, keyChord);
+        classifyCommands(menu, &keyChord->keyChords);
+    }
+}
+
 Span*
 compileKeyChords(Menu* menu, char* source, const char* filepath)
 {
@@ -107,6 +121,7 @@ compileKeyChords(Menu* menu, char* source, const char* filepath)
 
     menu->compiledKeyChords = SPAN_FROM_VECTOR(&menu->arena, &chords, KeyChord);
     menu->keyChords         = &menu->compiledKeyChords;
+    classifyCommands(menu, menu->keyChords);
 
     if (menu->debug)
     {
@@ -5,8 +5,10 @@
 /* common includes */
 #include "common/common.h"
 #include "common/debug.h"
+#include "common/latency.h"
 #include "common/menu.h"
 #include "common/span.h"
+#include "common/trace.h"
 
 /* compiler includes */
 #include "compiler/compiler.h"
@@ -20,6 +22,13 @@ runMenu(Menu* menu)
     int        result = EX_SOFTWARE;
     MenuStatus status = MENU_STATUS_RUNNING;
 
+    /* Started before any key is pressed, so keys given with --press and the
+     * commands they spawn are traced too. */
+    if (menu->trace.path && traceStart(&menu->trace))
+    {
+        debugMsg(menu->debug, "Tracing to '%s', send SIGUSR1 to write it out.", menu->trace.path);
+    }
+
     /* Pre-press keys */
     if (menu->client.keys)
     {
@@ -41,8 +50,13 @@ runMenu(Menu* menu)
     else
     {
         result = menuDisplay(menu);
+        if (menu->latencyFile) latencyWrite(&menu->latency, menu->latencyFile);
     }
 
+    /* Let hooks queued behind a sync command run now the menu is gone. */
+    menuFinishCommands(menu);
+    if (menu->trace.path) traceWrite(&menu->trace);
+
     return result;
 }
 
@@ -0,0 +1,198 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Cairo includes */
+#include <cairo.h>
+
+/* common includes */
+#include "common/common.h"
+#include "common/memory.h"
+#include "common/vector.h"
+
+/* local includes */
+#include "cache.h"
+
+static bool
+entryMatches(const CacheEntry* entry, const Vector* key, uint64_t hash)
+{
+    assert(entry), assert(key);
+
+    if (!entry->surface || entry->hash != hash) return false;
+    if (entry->key.length != key->length) return false;
+    return memcmp(entry->key.data, key->data, key->length) == 0;
+}
+
+static void
+entryFree(CacheEntry* entry)
+{
+    assert(entry);
+
+    if (entry->surface) cairo_surface_destroy(entry->surface);
+    if (entry->key.data) vectorFree(&entry->key);
+    entry->surface  = NULL;
+    entry->hash     = 0;
+    entry->lastUsed = 0;
+}
+
+/* Like cacheLookup, but leaves the hit counts and recency alone. */
+bool
+cacheContains(const Cache* cache, const Vector* key)
+{
+    assert(cache), assert(key);
+    if (!cache->enabled) return false;
+
+    uint64_t hash = cacheKeyHash(key);
+    for (size_t i = 0; i < cache->capacity; i++)
+    {
+        if (entryMatches(&cache->entries[i], key, hash)) return true;
+    }
+
+    return false;
+}
+
+void
+cacheFree(Cache* cache)
+{
+    assert(cache);
+
+    for (size_t i = 0; i < cache->capacity; i++)
+    {
+        entryFree(&cache->entries[i]);
+    }
+
+    free(cache->entries);
+    cache->entries  = NULL;
+    cache->capacity = 0;
+    cache->enabled  = false;
+}
+
+void
+cacheInit(Cache* cache, size_t capacity, bool enabled)
+{
+    assert(cache), assert(capacity > 0);
+
+    cache->entries  = enabled ? ALLOCATE(CacheEntry, capacity) : NULL;
+    cache->capacity = enabled ? capacity : 0;
+    cache->tick     = 0;
+    cache->hits     = 0;
+    cache->misses   = 0;
+    cache->enabled  = enabled;
+
+    if (cache->entries) memset(cache->entries, 0, sizeof(CacheEntry) * capacity);
+}
+
+void
+cacheInsert(Cache* cache, const Vector* key, cairo_surface_t* surface)
+{
+    assert(cache), assert(key), assert(surface);
+    if (!cache->enabled) return;
+
+    /* Take the first free slot, otherwise evict the least recently used. */
+    CacheEntry* victim = &cache->entries[0];
+    for (size_t i = 0; i < cache->capacity; i++)
+    {
+        CacheEntry* entry = &cache->entries[i];
+        if (!entry->surface)
+        {
+            victim = entry;
+            break;
+        }
+        if (entry->lastUsed < victim->lastUsed) victim = entry;
+    }
+
+    entryFree(victim);
+    victim->surface  = cairo_surface_reference(surface);
+    victim->key      = vectorCopy(key);
+    victim->hash     = cacheKeyHash(key);
+    victim->lastUsed = ++cache->tick;
+}
+
+void
+cacheKeyAppend(Vector* key, const void* data, size_t size)
+{
+    assert(key), assert(data);
+
+    vectorAppendN(key, data, size);
+}
+
+void
+cacheKeyAppendString(Vector* key, const char* str, size_t length)
+{
+    assert(key);
+
+    static const char nullByte = '\0';
+
+    /* Terminate each string so adjacent fields can't run together. */
+    if (str) vectorAppendN(key, str, length);
+    vectorAppend(key, &nullByte);
+}
+
+uint64_t
+cacheKeyHash(const Vector* key)
+{
+    assert(key);
+
+    return hashBytes(FNV_OFFSET_BASIS, key->data, key->length);
+}
+
+cairo_surface_t*
+cacheLookup(Cache* cache, const Vector* key)
+{
+    assert(cache), assert(key);
+    if (!cache->enabled) return NULL;
+
+    uint64_t hash = cacheKeyHash(key);
+    for (size_t i = 0; i < cache->capacity; i++)
+    {
+        CacheEntry* entry = &cache->entries[i];
+        if (!entryMatches(entry, key, hash)) continue;
+
+        entry->lastUsed = ++cache->tick;
+        cache->hits++;
+        return entry->surface;
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+/* Insert every surface of 'from' that 'to' lacks, in the order 'from'
+ * took them in. 'from' keeps its references. */
+void
+cacheMerge(Cache* to, const Cache* from)
+{
+    assert(to), assert(from);
+
+    for (size_t i = 0; i < from->capacity; i++)
+    {
+        const CacheEntry* entry = &from->entries[i];
+        if (!entry->surface || cacheContains(to, &entry->key)) continue;
+
+        cacheInsert(to, &entry->key, entry->surface);
+    }
+}
+
+/* Like cacheLookup, but only refreshes the recency, the hit counts are left
+ * alone. Returns whether 'key' is cached. */
+bool
+cacheTouch(Cache* cache, const Vector* key)
+{
+    assert(cache), assert(key);
+    if (!cache->enabled) return false;
+
+    uint64_t hash = cacheKeyHash(key);
+    for (size_t i = 0; i < cache->capacity; i++)
+    {
+        CacheEntry* entry = &cache->entries[i];
+        if (!entryMatches(entry, key, hash)) continue;
+
+        entry->lastUsed = ++cache->tick;
+        return true;
+    }
+
+    return false;
+}
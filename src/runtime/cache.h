@@ -0,0 +1,47 @@
+#ifndef WK_RUNTIME_CACHE_H_
+#define WK_RUNTIME_CACHE_H_
+
+#include <cairo.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* common includes */
+#include "common/vector.h"
+
+#define CACHE_CELL_CAPACITY 256
+#define CACHE_CHROME_CAPACITY 4
+
+/* A rendered surface and the key bytes it was rendered from. The key holds
+ * everything that influences the pixels (text, colors, font, size, scale) so
+ * a hit can be composited without going through Pango again. */
+typedef struct
+{
+    cairo_surface_t* surface;
+    Vector           key;
+    uint64_t         hash;
+    uint64_t         lastUsed;
+} CacheEntry;
+
+typedef struct
+{
+    CacheEntry* entries;
+    size_t      capacity;
+    uint64_t    tick;
+    size_t      hits;
+    size_t      misses;
+    bool        enabled;
+} Cache;
+
+bool             cacheContains(const Cache* cache, const Vector* key);
+void             cacheFree(Cache* cache);
+void             cacheInit(Cache* cache, size_t capacity, bool enabled);
+void             cacheInsert(Cache* cache, const Vector* key, cairo_surface_t* surface);
+void             cacheKeyAppend(Vector* key, const void* data, size_t size);
+void             cacheKeyAppendString(Vector* key, const char* str, size_t length);
+uint64_t         cacheKeyHash(const Vector* key);
+cairo_surface_t* cacheLookup(Cache* cache, const Vector* key);
+bool             cacheTouch(Cache* cache, const Vector* key);
+void             cacheMerge(Cache* to, const Cache* from);
+
+#endif /* WK_RUNTIME_CACHE_H_ */
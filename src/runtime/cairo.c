@@ -1,9 +1,12 @@
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -18,13 +21,18 @@
 #include "common/common.h"
 #include "common/debug.h"
 #include "common/key_chord.h"
+#include "common/memory.h"
 #include "common/menu.h"
 #include "common/span.h"
 #include "common/vector.h"
 
 /* local includes */
+#include "cache.h"
 #include "cairo.h"
 
+/* Title offset recorded on cached chrome surfaces */
+static const cairo_user_data_key_t titleOffsetKey;
+
 /* Drawing context to store ellipsis state */
 typedef struct
 {
@@ -54,6 +62,9 @@ cairoCreateForSurface(Cairo* cairo, cairo_surface_t* surface)
     cairo->surface = surface;
     assert(cairo->scale > 0);
     cairo_surface_set_device_scale(surface, cairo->scale, cairo->scale);
+    cairoFrameInit(&cairo->frame);
+    cairo->damage  = cairo_region_create();
+    cairo->pending = NULL;
     return true;
 
 fail:
@@ -68,6 +79,9 @@ cairoDestroy(Cairo* cairo)
 
     if (cairo->cr) cairo_destroy(cairo->cr);
     if (cairo->surface) cairo_surface_destroy(cairo->surface);
+    if (cairo->damage) cairo_region_destroy(cairo->damage);
+    if (cairo->pending) cairo_region_destroy(cairo->pending);
+    cairoFrameFree(&cairo->frame);
 }
 
 static void
@@ -150,6 +164,65 @@ partitionGroups(const Span* keyChords, Vector* columns)
     }
 }
 
+/* The height of the title, headers, table padding, and border. */
+static uint32_t
+getChromeHeight(const Menu* menu)
+{
+    assert(menu);
+
+    /* Calculate table padding for height calculation - if -1, use cell padding,
+     * otherwise use the * specified value */
+    uint32_t tablePadding = (menu->tablePadding == -1)
+                                ? menu->hpadding
+                                : (menu->tablePadding < 0 ? 0U : (uint32_t)menu->tablePadding);
+
+    return menu->titleHeight + menu->headerHeight + (tablePadding * 2) + (menu->borderWidth * 2);
+}
+
+/* The rows of the grid that fit in 'height', at least one. */
+static uint32_t
+getVisibleRows(const Menu* menu, uint32_t height)
+{
+    assert(menu);
+
+    uint32_t chromeHeight = getChromeHeight(menu);
+    if (menu->cellHeight == 0 || chromeHeight + (menu->cellHeight * menu->rows) <= height) return menu->rows;
+
+    uint32_t rows = (height > chromeHeight) ? (height - chromeHeight) / menu->cellHeight : 0;
+    return rows ? rows : 1;
+}
+
+/* When every row does not fit in a frame 'height' tall, shrink the grid to
+ * the rows that do and split the chords into pages of that many rows. Only
+ * the current page is laid out and drawn. cairoHeight sizes the window for
+ * this but leaves the grid alone, it is paged here as a frame is laid out. */
+static void
+setPages(Menu* menu, uint32_t height)
+{
+    assert(menu);
+
+    uint32_t visibleRows = getVisibleRows(menu, height);
+    if (visibleRows >= menu->rows || menu->cols == 0)
+    {
+        menu->page      = 0;
+        menu->pageCount = 1;
+        return;
+    }
+
+    if (menuIsGrouped(menu))
+    {
+        menu->pageCount = (menu->rows + visibleRows - 1) / visibleRows;
+    }
+    else
+    {
+        uint32_t perPage = visibleRows * menu->cols;
+        menu->pageCount  = (menu->keyChords->count + perPage - 1) / perPage;
+    }
+
+    menu->rows = visibleRows;
+    if (menu->page >= menu->pageCount) menu->page = menu->pageCount - 1;
+}
+
 uint32_t
 cairoHeight(Menu* menu, cairo_surface_t* surface, uint32_t maxHeight)
 {
@@ -191,17 +264,9 @@ cairoHeight(Menu* menu, cairo_surface_t* surface, uint32_t maxHeight)
         menu->headerHeight = 0;
     }
 
-    /* Calculate table padding for height calculation - if -1, use cell padding,
-     * otherwise use the * specified value */
-    uint32_t tablePadding = (menu->tablePadding == -1)
-                                ? menu->hpadding
-                                : (menu->tablePadding < 0 ? 0U : (uint32_t)menu->tablePadding);
-
-    height = menu->titleHeight +
-             menu->headerHeight +
-             (menu->cellHeight * menu->rows) +
-             (tablePadding * 2) +
-             (menu->borderWidth * 2);
+    /* A menu taller than maxHeight gets a window for the rows that fit,
+     * see setPages. */
+    height = getChromeHeight(menu) + (menu->cellHeight * getVisibleRows(menu, maxHeight));
 
     return height > maxHeight ? maxHeight : height;
 }
@@ -244,26 +309,33 @@ cairoPaintInit(Menu* menu, CairoPaint* paint)
     paint->headerFont = menu->headerFont ? menu->headerFont : menu->font;
 }
 
-static bool
-setSourceRgba(cairo_t* cr, CairoPaint* paint, MenuColor type)
+static CairoColor*
+getPaintColor(CairoPaint* paint, MenuColor type)
 {
-    assert(cr), assert(paint);
-
-    CairoColor* color = NULL;
+    assert(paint);
 
     switch (type)
     {
-    case MENU_COLOR_KEY: color = &paint->fgKey; break;
-    case MENU_COLOR_DELIMITER: color = &paint->fgDelimiter; break;
-    case MENU_COLOR_PREFIX: color = &paint->fgPrefix; break;
-    case MENU_COLOR_CHORD: color = &paint->fgChord; break;
-    case MENU_COLOR_TITLE: color = &paint->fgTitle; break;
-    case MENU_COLOR_GOTO: color = &paint->fgGoto; break;
-    case MENU_COLOR_HEADER: color = &paint->fgHeader; break;
-    case MENU_COLOR_BACKGROUND: color = &paint->bg; break;
-    case MENU_COLOR_BORDER: color = &paint->bd; break;
-    default: errorMsg("Invalid color request %d", type); return false;
+    case MENU_COLOR_KEY: return &paint->fgKey;
+    case MENU_COLOR_DELIMITER: return &paint->fgDelimiter;
+    case MENU_COLOR_PREFIX: return &paint->fgPrefix;
+    case MENU_COLOR_CHORD: return &paint->fgChord;
+    case MENU_COLOR_TITLE: return &paint->fgTitle;
+    case MENU_COLOR_GOTO: return &paint->fgGoto;
+    case MENU_COLOR_HEADER: return &paint->fgHeader;
+    case MENU_COLOR_BACKGROUND: return &paint->bg;
+    case MENU_COLOR_BORDER: return &paint->bd;
+    default: errorMsg("Invalid color request %d", type); return NULL;
     }
+}
+
+static bool
+setSourceRgba(cairo_t* cr, CairoPaint* paint, MenuColor type)
+{
+    assert(cr), assert(paint);
+
+    CairoColor* color = getPaintColor(paint, type);
+    if (!color) return false;
 
     cairo_set_source_rgba(cr, color->r, color->g, color->b, color->a);
     return true;
@@ -294,7 +366,11 @@ drawBackground(cairo_t* cr, CairoPaint* paint, Menu* menu, uint32_t width, uint3
 
     if (!radius)
     {
+        /* An opaque, square background replaces everything underneath it,
+         * so there is nothing to blend. */
+        if (paint->bg.a >= 1.0f) cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
         cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
     }
     else
     {
@@ -492,13 +568,39 @@ drawTitleText(
 
     if (!setSourceRgba(cr, paint, MENU_COLOR_TITLE)) return false;
 
+    /* Paged menus show their position after the title, e.g. 'Title (2/5)'.
+     * A title too long for the buffer is cut at a character boundary so the
+     * position still follows it. */
+    const char* title = menu->title;
+    char        pagedTitle[256];
+    if (menu->pageCount > 1)
+    {
+        size_t length = strlen(menu->title);
+        size_t room   = sizeof(pagedTitle) - 32;
+        if (length > room)
+        {
+            length = room;
+            while (length > 0 && ((unsigned char)menu->title[length] & 0xC0) == 0x80) length--;
+        }
+
+        snprintf(
+            pagedTitle,
+            sizeof(pagedTitle),
+            "%.*s (%u/%u)",
+            (int)length,
+            menu->title,
+            menu->page + 1,
+            menu->pageCount);
+        title = pagedTitle;
+    }
+
     PangoFontDescription* fontDesc = pango_font_description_from_string(paint->titleFont);
     PangoLayout*          layout   = pango_cairo_create_layout(cr);
 
     pango_layout_set_font_description(layout, fontDesc);
 
     int textw, texth;
-    pango_layout_set_text(layout, menu->title, -1);
+    pango_layout_set_text(layout, title, -1);
     pango_layout_get_pixel_size(layout, &textw, &texth);
 
     uint32_t centeredX = x;
@@ -509,7 +611,7 @@ drawTitleText(
 
     uint32_t titleX = centeredX;
     uint32_t titleY = y;
-    drawText(cr, layout, menu->title, &cellw, &titleX, &titleY, ellipsisWidth);
+    drawText(cr, layout, title, &cellw, &titleX, &titleY, ellipsisWidth);
 
     *yOffset = texth + menu->hpadding;
 
@@ -519,6 +621,271 @@ drawTitleText(
     return true;
 }
 
+/* Options set on 'from' itself win over its target's, which lets a context
+ * drawing to an offscreen image carry the options of the window. */
+static void
+copyFontOptions(cairo_t* from, cairo_t* to, bool allowSubpixel)
+{
+    assert(from), assert(to);
+
+    cairo_font_options_t* options = cairo_font_options_create();
+    cairo_font_options_t* own     = cairo_font_options_create();
+    cairo_surface_get_font_options(cairo_get_target(from), options);
+    cairo_get_font_options(from, own);
+    cairo_font_options_merge(options, own);
+    cairo_font_options_destroy(own);
+    if (!allowSubpixel && cairo_font_options_get_antialias(options) == CAIRO_ANTIALIAS_SUBPIXEL)
+    {
+        cairo_font_options_set_antialias(options, CAIRO_ANTIALIAS_GRAY);
+    }
+    cairo_set_font_options(to, options);
+    cairo_font_options_destroy(options);
+}
+
+static double
+getTargetScale(cairo_t* cr)
+{
+    assert(cr);
+
+    double scale = 1.0;
+    double unused;
+    cairo_surface_get_device_scale(cairo_get_target(cr), &scale, &unused);
+    return scale;
+}
+
+static bool
+drawChromeDirect(
+    cairo_t*    cr,
+    CairoPaint* paint,
+    Menu*       menu,
+    uint32_t    width,
+    uint32_t    height,
+    uint32_t*   titleOffset,
+    uint32_t    titlew,
+    uint32_t    x,
+    uint32_t    y,
+    int         ellipsisWidth)
+{
+    assert(cr), assert(paint), assert(menu), assert(titleOffset);
+
+    if (!drawBackground(cr, paint, menu, width, height))
+    {
+        errorMsg("Could not draw background.");
+        return false;
+    }
+
+    if (!drawBorder(cr, paint, menu, width, height))
+    {
+        errorMsg("Could not draw border.");
+        return false;
+    }
+
+    if (!drawTitleText(cr, paint, menu, titleOffset, titlew, x, y, ellipsisWidth))
+    {
+        errorMsg("Failed to draw menu title.");
+        return false;
+    }
+
+    return true;
+}
+
+static void
+makeChromeKey(
+    Vector*     key,
+    CairoPaint* paint,
+    Menu*       menu,
+    uint32_t    width,
+    uint32_t    height,
+    uint32_t    titlew,
+    uint32_t    x,
+    uint32_t    y,
+    double      scale,
+    int         ellipsisWidth)
+{
+    assert(key), assert(paint), assert(menu);
+
+    const char* title = menu->title ? menu->title : "";
+
+    cacheKeyAppend(key, &width, sizeof(width));
+    cacheKeyAppend(key, &height, sizeof(height));
+    cacheKeyAppend(key, &scale, sizeof(scale));
+    cacheKeyAppend(key, &paint->bg, sizeof(paint->bg));
+    cacheKeyAppend(key, &paint->bd, sizeof(paint->bd));
+    cacheKeyAppend(key, &paint->fgTitle, sizeof(paint->fgTitle));
+    cacheKeyAppend(key, &menu->borderRadius, sizeof(menu->borderRadius));
+    cacheKeyAppend(key, &menu->borderWidth, sizeof(menu->borderWidth));
+    cacheKeyAppend(key, &menu->hpadding, sizeof(menu->hpadding));
+    cacheKeyAppendString(key, title, strlen(title));
+    cacheKeyAppend(key, &menu->page, sizeof(menu->page));
+    cacheKeyAppend(key, &menu->pageCount, sizeof(menu->pageCount));
+    cacheKeyAppendString(key, paint->titleFont, strlen(paint->titleFont));
+    cacheKeyAppend(key, &titlew, sizeof(titlew));
+    cacheKeyAppend(key, &x, sizeof(x));
+    cacheKeyAppend(key, &y, sizeof(y));
+    cacheKeyAppend(key, &ellipsisWidth, sizeof(ellipsisWidth));
+}
+
+static cairo_surface_t*
+renderChrome(
+    cairo_t*    cr,
+    CairoPaint* paint,
+    Menu*       menu,
+    uint32_t    width,
+    uint32_t    height,
+    uint32_t    titlew,
+    uint32_t    x,
+    uint32_t    y,
+    double      scale,
+    int         ellipsisWidth)
+{
+    assert(cr), assert(paint), assert(menu);
+
+    /* Without transparency or rounded corners there is no alpha to keep. */
+    cairo_format_t format = (paint->bg.a >= 1.0f && !menu->borderRadius)
+                                ? CAIRO_FORMAT_RGB24
+                                : CAIRO_FORMAT_ARGB32;
+
+    cairo_surface_t* surface = cairo_surface_create_similar_image(
+        cairo_get_target(cr),
+        format,
+        (int)ceil(width * scale),
+        (int)ceil(height * scale));
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+    cairo_surface_set_device_scale(surface, scale, scale);
+
+    cairo_t* chromeCr = cairo_create(surface);
+    copyFontOptions(cr, chromeCr, true);
+
+    uint32_t titleOffset = 0;
+    bool     result      = drawChromeDirect(
+        chromeCr,
+        paint,
+        menu,
+        width,
+        height,
+        &titleOffset,
+        titlew,
+        x,
+        y,
+        ellipsisWidth);
+
+    cairo_destroy(chromeCr);
+    cairo_surface_flush(surface);
+
+    if (!result)
+    {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    cairo_surface_set_user_data(surface, &titleOffsetKey, (void*)(uintptr_t)titleOffset, NULL);
+    return surface;
+}
+
+static uint32_t
+measureTitleOffset(cairo_t* cr, CairoPaint* paint, Menu* menu)
+{
+    assert(cr), assert(paint), assert(menu);
+
+    if (!menu->title || strlen(menu->title) == 0) return 0;
+
+    PangoFontDescription* fontDesc = pango_font_description_from_string(paint->titleFont);
+    PangoLayout*          layout   = pango_cairo_create_layout(cr);
+
+    pango_layout_set_font_description(layout, fontDesc);
+
+    int textw, texth;
+    pango_layout_set_text(layout, menu->title, -1);
+    pango_layout_get_pixel_size(layout, &textw, &texth);
+
+    pango_font_description_free(fontDesc);
+    g_object_unref(layout);
+
+    return texth + menu->hpadding;
+}
+
+/* Returns the chrome surface for this frame, rendering it on a cache miss.
+ * Returns NULL when the cache is unavailable, in which case the title is
+ * only measured and the chrome must be drawn directly. */
+static cairo_surface_t*
+getChrome(
+    cairo_t*      cr,
+    CairoPaint*   paint,
+    Cache*        cache,
+    Menu*         menu,
+    const Vector* key,
+    uint32_t*     titleOffset,
+    uint32_t      width,
+    uint32_t      height,
+    uint32_t      titlew,
+    uint32_t      x,
+    uint32_t      y,
+    double        scale,
+    int           ellipsisWidth)
+{
+    assert(cr), assert(paint), assert(menu), assert(key), assert(titleOffset);
+
+    cairo_surface_t* surface = NULL;
+
+    if (cache && cache->enabled)
+    {
+        surface = cacheLookup(cache, key);
+        if (surface)
+        {
+            cairo_surface_reference(surface);
+        }
+        else
+        {
+            surface = renderChrome(cr, paint, menu, width, height, titlew, x, y, scale, ellipsisWidth);
+            if (surface) cacheInsert(cache, key, surface);
+        }
+    }
+
+    if (surface)
+    {
+        *titleOffset = (uint32_t)(uintptr_t)cairo_surface_get_user_data(surface, &titleOffsetKey);
+    }
+    else
+    {
+        *titleOffset = measureTitleOffset(cr, paint, menu);
+    }
+
+    return surface;
+}
+
+static bool
+paintChrome(
+    cairo_t*         cr,
+    cairo_surface_t* chrome,
+    CairoPaint*      paint,
+    Menu*            menu,
+    uint32_t         width,
+    uint32_t         height,
+    uint32_t         titlew,
+    uint32_t         x,
+    uint32_t         y,
+    int              ellipsisWidth)
+{
+    assert(cr), assert(paint), assert(menu);
+
+    if (!chrome)
+    {
+        uint32_t titleOffset = 0;
+        return drawChromeDirect(cr, paint, menu, width, height, &titleOffset, titlew, x, y, ellipsisWidth);
+    }
+
+    /* The chrome is the bottom layer of the frame, so copy it in place. */
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, chrome, 0, 0);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    return true;
+}
+
 static bool
 drawKeyModText(
     cairo_t*     cr,
@@ -589,6 +956,16 @@ drawDelimiterText(
     return drawText(cr, layout, delimiter, cellw, x, y, ellipsisWidth);
 }
 
+static MenuColor
+getDescriptionColor(const KeyChord* keyChord)
+{
+    assert(keyChord);
+
+    if (SPAN_LENGTH(&keyChord->keyChords) > 0) return MENU_COLOR_PREFIX;
+    if (propIsSet(keyChord, KC_PROP_GOTO)) return MENU_COLOR_GOTO;
+    return MENU_COLOR_CHORD;
+}
+
 static bool
 drawDescriptionText(
     cairo_t*        cr,
@@ -602,11 +979,7 @@ drawDescriptionText(
 {
     assert(cr), assert(paint), assert(layout), assert(keyChord), assert(cellw), assert(x), assert(y);
 
-    MenuColor descColor = MENU_COLOR_CHORD;
-    if (SPAN_LENGTH(&keyChord->keyChords) > 0) descColor = MENU_COLOR_PREFIX;
-    else if (propIsSet(keyChord, KC_PROP_GOTO)) descColor = MENU_COLOR_GOTO;
-
-    if (!setSourceRgba(cr, paint, descColor)) return false;
+    if (!setSourceRgba(cr, paint, getDescriptionColor(keyChord))) return false;
 
     return drawString(
         cr,
@@ -639,147 +1012,815 @@ drawHintText(
 }
 
 static void
-drawHeaderText(
-    cairo_t*        cr,
+makeHintCellKey(
+    Vector*         key,
     CairoPaint*     paint,
-    const KeyChord* first,
-    HeaderAlign     align,
-    uint32_t        colX,
-    uint32_t        y,
+    Menu*           menu,
+    const KeyChord* keyChord,
     uint32_t        cellWidth,
-    uint32_t        wpadding)
+    uint32_t        cellHeight,
+    double          scale,
+    int             ellipsisWidth)
 {
-    assert(cr), assert(paint), assert(first);
+    assert(key), assert(paint), assert(menu), assert(keyChord);
+
+    const String* desc      = propStringConst(keyChord, KC_PROP_DESCRIPTION);
+    CairoColor*   descColor = getPaintColor(paint, getDescriptionColor(keyChord));
+
+    cacheKeyAppend(key, &keyChord->key.mods, sizeof(keyChord->key.mods));
+    cacheKeyAppendString(key, keyChord->key.repr.data, keyChord->key.repr.length);
+    cacheKeyAppendString(key, menu->delimiter, strlen(menu->delimiter));
+    cacheKeyAppendString(key, desc ? desc->data : NULL, desc ? desc->length : 0);
+    cacheKeyAppendString(key, paint->font, strlen(paint->font));
+    cacheKeyAppend(key, &paint->fgKey, sizeof(paint->fgKey));
+    cacheKeyAppend(key, &paint->fgDelimiter, sizeof(paint->fgDelimiter));
+    if (descColor) cacheKeyAppend(key, descColor, sizeof(*descColor));
+    cacheKeyAppend(key, &cellWidth, sizeof(cellWidth));
+    cacheKeyAppend(key, &cellHeight, sizeof(cellHeight));
+    cacheKeyAppend(key, &menu->wpadding, sizeof(menu->wpadding));
+    cacheKeyAppend(key, &menu->hpadding, sizeof(menu->hpadding));
+    cacheKeyAppend(key, &scale, sizeof(scale));
+    cacheKeyAppend(key, &ellipsisWidth, sizeof(ellipsisWidth));
+}
 
-    const String* name = propStringConst(first, KC_PROP_GROUP);
-    if (!name || stringIsEmpty(name)) return;
+/* A context drawing to a transparent image for one cell, the raster the
+ * cell cache holds. Needs the target of 'cr', so call it on the thread that
+ * owns it. */
+static cairo_t*
+createHintCell(cairo_t* cr, uint32_t cellWidth, uint32_t cellHeight, double scale)
+{
+    assert(cr);
 
-    PangoFontDescription* fontDesc = pango_font_description_from_string(paint->headerFont);
-    PangoLayout*          layout   = pango_cairo_create_layout(cr);
+    cairo_surface_t* surface = cairo_surface_create_similar_image(
+        cairo_get_target(cr),
+        CAIRO_FORMAT_ARGB32,
+        (int)ceil(cellWidth * scale),
+        (int)ceil(cellHeight * scale));
+    if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+    cairo_surface_set_device_scale(surface, scale, scale);
 
-    pango_layout_set_font_description(layout, fontDesc);
+    cairo_t* cellCr = cairo_create(surface);
+    cairo_surface_destroy(surface);
 
-    /* Measure the ellipsis in the header's own font so truncation math never
-     * uses a threshold computed from a differently-sized chord font. */
-    int ellipsisWidth, ellipsisHeight;
-    pango_layout_set_text(layout, "...", -1);
-    pango_layout_get_pixel_size(layout, &ellipsisWidth, &ellipsisHeight);
+    /* Match the target's hinting so cached and direct text share metrics.
+     * Subpixel coverage can't be composited from a transparent surface, so
+     * fall back to grayscale antialiasing for the cached raster. */
+    copyFontOptions(cr, cellCr, false);
+    return cellCr;
+}
 
-    uint32_t cellw = cellWidth - (wpadding * 2);
-    if ((uint32_t)ellipsisWidth > cellw) ellipsisWidth = 0;
+/* Shape and draw a hint into a context from createHintCell. Touches nothing
+ * but 'cellCr', so tiles run it on their own threads. */
+static void
+drawHintCellText(
+    cairo_t*        cellCr,
+    CairoPaint*     paint,
+    Menu*           menu,
+    const KeyChord* keyChord,
+    uint32_t        cellWidth,
+    int             ellipsisWidth)
+{
+    assert(cellCr), assert(paint), assert(menu), assert(keyChord);
 
-    int textw, texth;
-    pango_layout_set_text(layout, name->data, -1);
-    pango_layout_get_pixel_size(layout, &textw, &texth);
+    PangoFontDescription* fontDesc = pango_font_description_from_string(paint->font);
+    PangoLayout*          layout   = pango_cairo_create_layout(cellCr);
 
-    uint32_t x = colX + wpadding;
-    if ((uint32_t)textw < cellw)
-    {
-        if (align == HEADER_ALIGN_CENTER) x = colX + wpadding + (cellw - (uint32_t)textw) / 2;
-        else if (align == HEADER_ALIGN_RIGHT) x = colX + cellWidth - wpadding - (uint32_t)textw;
-    }
+    pango_layout_set_font_description(layout, fontDesc);
+    pango_font_description_free(fontDesc);
 
-    if (setSourceRgba(cr, paint, MENU_COLOR_HEADER))
-    {
-        drawString(cr, layout, name, &cellw, &x, &y, ellipsisWidth);
-    }
+    drawHintText(
+        cellCr,
+        paint,
+        layout,
+        menu->delimiter,
+        keyChord,
+        cellWidth - (menu->wpadding * 2),
+        menu->wpadding,
+        menu->hpadding,
+        ellipsisWidth);
 
-    pango_font_description_free(fontDesc);
     g_object_unref(layout);
+    cairo_surface_flush(cairo_get_target(cellCr));
 }
 
-static void
-drawGroupedColumns(
+static cairo_surface_t*
+renderHintCell(
     cairo_t*        cr,
     CairoPaint*     paint,
     Menu*           menu,
-    PangoLayout*    layout,
-    uint32_t        startx,
-    uint32_t        starty,
+    const KeyChord* keyChord,
     uint32_t        cellWidth,
     uint32_t        cellHeight,
-    DrawingContext* ctx)
+    double          scale,
+    int             ellipsisWidth)
 {
-    assert(cr), assert(paint), assert(menu), assert(layout), assert(ctx);
-
-    Vector columns = VECTOR_INIT(GroupColumn);
-    partitionGroups(menu->keyChords, &columns);
+    assert(cr), assert(paint), assert(menu), assert(keyChord);
 
-    vectorForEach(&columns, GroupColumn, column)
-    {
-        uint32_t        colX  = startx + ((uint32_t)iter.index * cellWidth);
-        const KeyChord* first = SPAN_GET(menu->keyChords, const KeyChord, column->start);
+    cairo_t* cellCr = createHintCell(cr, cellWidth, cellHeight, scale);
+    if (!cellCr) return NULL;
 
-        drawHeaderText(
-            cr,
-            paint,
-            first,
-            menu->headerAlign,
-            colX,
-            starty + menu->hpadding,
-            cellWidth,
-            menu->wpadding);
+    drawHintCellText(cellCr, paint, menu, keyChord, cellWidth, ellipsisWidth);
 
-        for (size_t row = 0; row < column->count; row++)
-        {
-            const KeyChord* keyChord =
-                SPAN_GET(menu->keyChords, const KeyChord, column->start + row);
-            uint32_t x = colX + menu->wpadding;
-            uint32_t y = starty + menu->headerHeight + ((uint32_t)row * cellHeight) + menu->hpadding;
+    cairo_surface_t* surface = cairo_surface_reference(cairo_get_target(cellCr));
+    cairo_destroy(cellCr);
+    return surface;
+}
 
-            drawHintText(
-                cr,
-                paint,
-                layout,
-                menu->delimiter,
+static void
+drawHintCell(
+    cairo_t*        cr,
+    CairoPaint*     paint,
+    Cache*          cache,
+    Menu*           menu,
+    PangoLayout*    layout,
+    const KeyChord* keyChord,
+    const Vector*   key,
+    uint32_t        cellx,
+    uint32_t        celly,
+    uint32_t        cellWidth,
+    uint32_t        cellHeight,
+    double          scale,
+    int             ellipsisWidth)
+{
+    assert(cr), assert(paint), assert(menu), assert(layout), assert(keyChord), assert(key);
+
+    cairo_surface_t* surface = NULL;
+
+    if (cache && cache->enabled)
+    {
+        surface = cacheLookup(cache, key);
+        if (surface)
+        {
+            cairo_surface_reference(surface);
+        }
+        else
+        {
+            surface = renderHintCell(
+                cr,
+                paint,
+                menu,
                 keyChord,
-                cellWidth - (menu->wpadding * 2),
-                x,
-                y,
-                ctx->ellipsisWidth);
+                cellWidth,
+                cellHeight,
+                scale,
+                ellipsisWidth);
+            if (surface) cacheInsert(cache, key, surface);
         }
     }
 
-    vectorFree(&columns);
+    if (surface)
+    {
+        cairo_set_source_surface(cr, surface, cellx, celly);
+        cairo_rectangle(cr, cellx, celly, cellWidth, cellHeight);
+        cairo_fill(cr);
+        cairo_surface_destroy(surface);
+    }
+    else
+    {
+        drawHintText(
+            cr,
+            paint,
+            layout,
+            menu->delimiter,
+            keyChord,
+            cellWidth - (menu->wpadding * 2),
+            cellx + menu->wpadding,
+            celly + menu->hpadding,
+            ellipsisWidth);
+    }
 }
 
-static bool
-drawGrid(
+static void
+drawHeaderText(
     cairo_t*        cr,
     CairoPaint*     paint,
+    const KeyChord* first,
+    HeaderAlign     align,
+    uint32_t        colX,
+    uint32_t        y,
+    uint32_t        cellWidth,
+    uint32_t        wpadding)
+{
+    assert(cr), assert(paint), assert(first);
+
+    const String* name = propStringConst(first, KC_PROP_GROUP);
+    if (!name || stringIsEmpty(name)) return;
+
+    PangoFontDescription* fontDesc = pango_font_description_from_string(paint->headerFont);
+    PangoLayout*          layout   = pango_cairo_create_layout(cr);
+
+    pango_layout_set_font_description(layout, fontDesc);
+
+    /* Measure the ellipsis in the header's own font so truncation math never
+     * uses a threshold computed from a differently-sized chord font. */
+    int ellipsisWidth, ellipsisHeight;
+    pango_layout_set_text(layout, "...", -1);
+    pango_layout_get_pixel_size(layout, &ellipsisWidth, &ellipsisHeight);
+
+    uint32_t cellw = cellWidth - (wpadding * 2);
+    if ((uint32_t)ellipsisWidth > cellw) ellipsisWidth = 0;
+
+    int textw, texth;
+    pango_layout_set_text(layout, name->data, -1);
+    pango_layout_get_pixel_size(layout, &textw, &texth);
+
+    uint32_t x = colX + wpadding;
+    if ((uint32_t)textw < cellw)
+    {
+        if (align == HEADER_ALIGN_CENTER) x = colX + wpadding + (cellw - (uint32_t)textw) / 2;
+        else if (align == HEADER_ALIGN_RIGHT) x = colX + cellWidth - wpadding - (uint32_t)textw;
+    }
+
+    if (setSourceRgba(cr, paint, MENU_COLOR_HEADER))
+    {
+        drawString(cr, layout, name, &cellw, &x, &y, ellipsisWidth);
+    }
+
+    pango_font_description_free(fontDesc);
+    g_object_unref(layout);
+}
+
+static void
+makeHeaderKey(
+    Vector*         key,
+    CairoPaint*     paint,
     Menu*           menu,
+    const KeyChord* first,
+    uint32_t        cellWidth,
+    double          scale)
+{
+    assert(key), assert(paint), assert(menu), assert(first);
+
+    const String* name = propStringConst(first, KC_PROP_GROUP);
+
+    cacheKeyAppendString(key, name ? name->data : NULL, name ? name->length : 0);
+    cacheKeyAppendString(key, paint->headerFont, strlen(paint->headerFont));
+    cacheKeyAppend(key, &paint->fgHeader, sizeof(paint->fgHeader));
+    cacheKeyAppend(key, &menu->headerAlign, sizeof(menu->headerAlign));
+    cacheKeyAppend(key, &cellWidth, sizeof(cellWidth));
+    cacheKeyAppend(key, &menu->wpadding, sizeof(menu->wpadding));
+    cacheKeyAppend(key, &menu->hpadding, sizeof(menu->hpadding));
+    cacheKeyAppend(key, &scale, sizeof(scale));
+}
+
+/* A cell placed in the current frame, along with the key describing its
+ * contents. Headers of grouped columns are laid out as cells too. */
+typedef struct
+{
+    const KeyChord*       keyChord;
+    Vector                key;
+    cairo_rectangle_int_t rect;
+    bool                  header;
+} FrameCell;
+
+static void
+appendFrameCell(
+    Vector*         cells,
+    const KeyChord* keyChord,
+    uint32_t        x,
+    uint32_t        y,
     uint32_t        width,
     uint32_t        height,
-    DrawingContext* ctx)
+    bool            header)
 {
-    assert(cr), assert(paint), assert(menu);
+    assert(cells), assert(keyChord);
+
+    FrameCell cell = {
+        .keyChord = keyChord,
+        .key      = VECTOR_INIT(char),
+        .rect     = { .x = x, .y = y, .width = width, .height = height },
+        .header   = header,
+    };
+    vectorAppend(cells, &cell);
+}
 
-    if (menu->borderWidth * 2 >= width)
+static void
+layoutCells(
+    CairoPaint* paint,
+    Menu*       menu,
+    Vector*     cells,
+    uint32_t    startx,
+    uint32_t    starty,
+    uint32_t    cellWidth,
+    uint32_t    cellHeight,
+    double      scale,
+    int         ellipsisWidth)
+{
+    assert(paint), assert(menu), assert(cells);
+
+    if (menuIsGrouped(menu))
     {
-        errorMsg("Border is larger than menu width.");
-        return false;
+        Vector columns  = VECTOR_INIT(GroupColumn);
+        size_t firstRow = (size_t)menu->page * menu->rows;
+        partitionGroups(menu->keyChords, &columns);
+
+        vectorForEach(&columns, GroupColumn, column)
+        {
+            uint32_t        colX  = startx + ((uint32_t)iter.index * cellWidth);
+            const KeyChord* first = SPAN_GET(menu->keyChords, const KeyChord, column->start);
+
+            appendFrameCell(cells, first, colX, starty, cellWidth, menu->headerHeight, true);
+
+            for (size_t row = firstRow; row < column->count && row < firstRow + menu->rows; row++)
+            {
+                const KeyChord* keyChord =
+                    SPAN_GET(menu->keyChords, const KeyChord, column->start + row);
+                uint32_t y = starty + menu->headerHeight + ((uint32_t)(row - firstRow) * cellHeight);
+
+                appendFrameCell(cells, keyChord, colX, y, cellWidth, cellHeight, false);
+            }
+        }
+
+        vectorFree(&columns);
+    }
+    else
+    {
+        size_t chordIdx = (size_t)menu->page * menu->rows * menu->cols;
+        for (uint32_t i = 0; i < menu->cols && chordIdx < menu->keyChords->count; i++)
+        {
+            uint32_t x = startx + (i * cellWidth);
+            for (uint32_t j = 0; j < menu->rows && chordIdx < menu->keyChords->count; j++)
+            {
+                const KeyChord* keyChord = SPAN_GET(menu->keyChords, const KeyChord, chordIdx++);
+                uint32_t        y        = starty + (j * cellHeight);
+
+                appendFrameCell(cells, keyChord, x, y, cellWidth, cellHeight, false);
+            }
+        }
+    }
+
+    vectorForEach(cells, FrameCell, cell)
+    {
+        if (cell->header)
+        {
+            makeHeaderKey(&cell->key, paint, menu, cell->keyChord, cellWidth, scale);
+        }
+        else
+        {
+            makeHintCellKey(
+                &cell->key,
+                paint,
+                menu,
+                cell->keyChord,
+                cellWidth,
+                cellHeight,
+                scale,
+                ellipsisWidth);
+        }
+    }
+}
+
+static void
+freeFrameCells(Vector* cells)
+{
+    assert(cells);
+
+    vectorForEach(cells, FrameCell, cell)
+    {
+        vectorFree(&cell->key);
+    }
+    vectorFree(cells);
+}
+
+void
+cairoFrameCopy(CairoFrame* to, const CairoFrame* from)
+{
+    assert(to), assert(from);
+
+    vectorClear(&to->cells);
+    if (!vectorIsEmpty(&from->cells))
+    {
+        vectorAppendN(&to->cells, from->cells.data, vectorLength(&from->cells));
+    }
+    to->chromeHash = from->chromeHash;
+    to->width      = from->width;
+    to->height     = from->height;
+    to->scale      = from->scale;
+    to->valid      = from->valid;
+}
+
+void
+cairoFrameFree(CairoFrame* frame)
+{
+    assert(frame);
+
+    vectorFree(&frame->cells);
+    frame->valid = false;
+}
+
+void
+cairoFrameInit(CairoFrame* frame)
+{
+    assert(frame);
+
+    frame->cells      = VECTOR_INIT(CairoCell);
+    frame->chromeHash = 0;
+    frame->width      = 0;
+    frame->height     = 0;
+    frame->scale      = 0;
+    frame->valid      = false;
+}
+
+/* Union into 'damage' every area that differs between two frames. Cells are
+ * compared by position and content hash; anything that changes the chrome or
+ * the frame size damages the whole frame. */
+static void
+frameDamage(const CairoFrame* prev, const CairoFrame* next, cairo_region_t* damage)
+{
+    assert(next), assert(damage);
+
+    if (!prev ||
+        !prev->valid ||
+        prev->width != next->width ||
+        prev->height != next->height ||
+        prev->scale != next->scale ||
+        prev->chromeHash != next->chromeHash)
+    {
+        cairo_rectangle_int_t full = { 0, 0, (int)next->width, (int)next->height };
+        cairo_region_union_rectangle(damage, &full);
+        return;
+    }
+
+    size_t prevCount = vectorLength(&prev->cells);
+    size_t nextCount = vectorLength(&next->cells);
+    size_t count     = prevCount > nextCount ? prevCount : nextCount;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const CairoCell* a = i < prevCount ? VECTOR_GET(&prev->cells, const CairoCell, i) : NULL;
+        const CairoCell* b = i < nextCount ? VECTOR_GET(&next->cells, const CairoCell, i) : NULL;
+
+        if (a && b && a->hash == b->hash && memcmp(&a->rect, &b->rect, sizeof(a->rect)) == 0)
+        {
+            continue;
+        }
+
+        if (a) cairo_region_union_rectangle(damage, &a->rect);
+        if (b) cairo_region_union_rectangle(damage, &b->rect);
+    }
+}
+
+static void
+clipToRegion(cairo_t* cr, const cairo_region_t* region)
+{
+    assert(cr), assert(region);
+
+    int count = cairo_region_num_rectangles(region);
+    for (int i = 0; i < count; i++)
+    {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(region, i, &rect);
+        cairo_rectangle(cr, rect.x, rect.y, rect.width, rect.height);
+    }
+    cairo_clip(cr);
+}
+
+static void
+resetRegion(cairo_region_t** region)
+{
+    assert(region);
+
+    if (*region) cairo_region_destroy(*region);
+    *region = cairo_region_create();
+}
+
+/* A run of whole columns rendered on a tile thread. The main thread hands
+ * each tile a context per cell the cell cache lacks, the tile only shapes
+ * text into them, so workers share nothing but the read-only paint, menu,
+ * and cells. */
+typedef struct RenderTile
+{
+    CairoPaint*   paint;
+    Menu*         menu;
+    const Vector* cells;
+    cairo_t**     contexts;
+    size_t        first;
+    size_t        last;
+    uint32_t      cellWidth;
+    int           ellipsisWidth;
+} RenderTile;
+
+static void
+renderTile(RenderTile* tile)
+{
+    assert(tile);
+
+    for (size_t i = tile->first; i < tile->last; i++)
+    {
+        if (!tile->contexts[i]) continue;
+
+        const FrameCell* cell = VECTOR_GET(tile->cells, const FrameCell, i);
+        drawHintCellText(
+            tile->contexts[i],
+            tile->paint,
+            tile->menu,
+            cell->keyChord,
+            tile->cellWidth,
+            tile->ellipsisWidth);
+    }
+}
+
+/* Take tiles off the queue until the pool stops. Pango keeps a font map per
+ * thread, so a thread that lives as long as the window builds it once. */
+static void*
+tileWorker(void* data)
+{
+    assert(data);
+
+    CairoTiles* tiles = data;
+
+    pthread_mutex_lock(&tiles->lock);
+    while (true)
+    {
+        while (!tiles->stop && tiles->next >= tiles->jobCount)
+        {
+            pthread_cond_wait(&tiles->queued, &tiles->lock);
+        }
+        if (tiles->stop) break;
+
+        RenderTile* tile = &tiles->jobs[tiles->next++];
+        pthread_mutex_unlock(&tiles->lock);
+        renderTile(tile);
+        pthread_mutex_lock(&tiles->lock);
+
+        if (--tiles->remaining == 0) pthread_cond_signal(&tiles->finished);
+    }
+    pthread_mutex_unlock(&tiles->lock);
+
+    return NULL;
+}
+
+/* Start the pool on the first tiled frame. Returns how many threads run. */
+static uint32_t
+startTileThreads(CairoTiles* tiles, uint32_t count)
+{
+    assert(tiles);
+
+    if (tiles->threads) return tiles->count;
+
+    pthread_mutex_init(&tiles->lock, NULL);
+    pthread_cond_init(&tiles->queued, NULL);
+    pthread_cond_init(&tiles->finished, NULL);
+    tiles->threads = ALLOCATE(pthread_t, count);
+    tiles->stop    = false;
+
+    for (tiles->count = 0; tiles->count < count; tiles->count++)
+    {
+        if (pthread_create(&tiles->threads[tiles->count], NULL, tileWorker, tiles) != 0) break;
+    }
+
+    return tiles->count;
+}
+
+/* Hand 'count' tiles to the pool and wait until all are rendered. Without a
+ * thread to run them they are rendered here. */
+static void
+runTiles(CairoTiles* tiles, RenderTile* jobs, uint32_t count)
+{
+    assert(tiles), assert(jobs);
+
+    if (!tiles->count)
+    {
+        for (uint32_t i = 0; i < count; i++) renderTile(&jobs[i]);
+        return;
+    }
+
+    pthread_mutex_lock(&tiles->lock);
+    tiles->jobs      = jobs;
+    tiles->jobCount  = count;
+    tiles->next      = 0;
+    tiles->remaining = count;
+    pthread_cond_broadcast(&tiles->queued);
+    while (tiles->remaining) pthread_cond_wait(&tiles->finished, &tiles->lock);
+    tiles->jobs     = NULL;
+    tiles->jobCount = 0;
+    tiles->next     = 0;
+    pthread_mutex_unlock(&tiles->lock);
+}
+
+/* Split the cells into one tile of whole columns per thread and composite
+ * them into 'cr'. Cells found in the cell cache are taken from it, the rest
+ * are rendered on the threads of 'tiles' and inserted, so a tiled frame fills the
+ * cache like one drawn on this thread. Headers are drawn here. Returns false
+ * without drawing anything when the frame can't be tiled, so the caller can
+ * draw it on this thread instead. */
+static bool
+drawTiles(
+    cairo_t*      cr,
+    CairoPaint*   paint,
+    Cache*        cache,
+    CairoTiles*   tiles,
+    Menu*         menu,
+    const Vector* cells,
+    uint32_t      startx,
+    uint32_t      cellWidth,
+    uint32_t      cellHeight,
+    double        scale,
+    int           ellipsisWidth)
+{
+    assert(cr), assert(paint), assert(menu), assert(cells);
+
+    uint32_t count = menu->renderThreads < menu->cols ? menu->renderThreads : menu->cols;
+    if (!tiles || count < 2 || cellWidth == 0 || vectorIsEmpty(cells)) return false;
+
+    uint32_t threads = startTileThreads(tiles, menu->renderThreads);
+
+    bool              result   = false;
+    size_t            length   = vectorLength(cells);
+    uint32_t          used     = 0;
+    size_t            missing  = 0;
+    RenderTile*       jobs     = ALLOCATE(RenderTile, count);
+    cairo_t**         contexts = ALLOCATE(cairo_t*, length);
+    cairo_surface_t** hits     = ALLOCATE(cairo_surface_t*, length);
+
+    memset(jobs, 0, sizeof(RenderTile) * count);
+    memset(contexts, 0, sizeof(cairo_t*) * length);
+    memset(hits, 0, sizeof(cairo_surface_t*) * length);
+
+    /* The cache and the target belong to this thread, so lookups and the
+     * cell surfaces are done before any tile starts. */
+    for (size_t i = 0; i < length; i++)
+    {
+        const FrameCell* cell = VECTOR_GET(cells, const FrameCell, i);
+        if (cell->header) continue;
+
+        /* Inserting the rendered cells may evict a hit before it is drawn. */
+        if (cache && cache->enabled) hits[i] = cacheLookup(cache, &cell->key);
+        if (hits[i])
+        {
+            cairo_surface_reference(hits[i]);
+            continue;
+        }
+
+        contexts[i] = createHintCell(cr, cellWidth, cellHeight, scale);
+        if (!contexts[i]) goto done;
+        missing++;
+    }
+
+    /* Cells are laid out column by column, so each tile is a contiguous run. */
+    size_t first = 0;
+    for (uint32_t t = 0; t < count && first < length; t++)
+    {
+        uint32_t endCol = (uint32_t)(((uint64_t)(t + 1) * menu->cols) / count);
+        size_t   last   = first;
+        while (last < length)
+        {
+            const FrameCell* cell = VECTOR_GET(cells, const FrameCell, last);
+            if ((uint32_t)(cell->rect.x - startx) / cellWidth >= endCol) break;
+            last++;
+        }
+
+        if (last == first) continue;
+
+        RenderTile* tile    = &jobs[used++];
+        tile->paint         = paint;
+        tile->menu          = menu;
+        tile->cells         = cells;
+        tile->contexts      = contexts;
+        tile->first         = first;
+        tile->last          = last;
+        tile->cellWidth     = cellWidth;
+        tile->ellipsisWidth = ellipsisWidth;
+        first               = last;
+    }
+
+    runTiles(tiles, jobs, used);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        const FrameCell* cell = VECTOR_GET(cells, const FrameCell, i);
+        if (cell->header)
+        {
+            drawHeaderText(
+                cr,
+                paint,
+                cell->keyChord,
+                menu->headerAlign,
+                cell->rect.x,
+                cell->rect.y + menu->hpadding,
+                cellWidth,
+                menu->wpadding);
+            continue;
+        }
+
+        cairo_surface_t* surface = hits[i] ? hits[i] : cairo_get_target(contexts[i]);
+        if (contexts[i] && cache) cacheInsert(cache, &cell->key, surface);
+
+        cairo_set_source_surface(cr, surface, cell->rect.x, cell->rect.y);
+        cairo_rectangle(cr, cell->rect.x, cell->rect.y, cellWidth, cellHeight);
+        cairo_fill(cr);
     }
 
+    if (menu->debug && !traceIsRunning(&menu->trace))
+    {
+        debugMsg(true, "Drew %u tile(s) on %u thread(s), %zu cell(s) rendered.", used, threads, missing);
+    }
+
+    result = true;
+
+done:
+    for (size_t i = 0; i < length; i++)
+    {
+        if (contexts[i]) cairo_destroy(contexts[i]);
+        if (hits[i]) cairo_surface_destroy(hits[i]);
+    }
+
+    free(hits);
+    free(contexts);
+    free(jobs);
+    return result;
+}
+
+/* Where the cells of the current level go in a frame 'width' wide. */
+typedef struct
+{
+    uint32_t startx;
+    uint32_t starty;
+    uint32_t cellWidth;
+    uint32_t titlew;
+} GridGeometry;
+
+static void
+measureGrid(const Menu* menu, uint32_t width, GridGeometry* grid)
+{
+    assert(menu), assert(grid);
+
     uint32_t tablePaddingX     = (menu->tablePadding == -1)
                                      ? menu->wpadding
                                      : (menu->tablePadding < 0 ? 0U : (uint32_t)menu->tablePadding);
     uint32_t tablePaddingY     = (menu->tablePadding == -1)
                                      ? menu->hpadding
                                      : (menu->tablePadding < 0 ? 0U : (uint32_t)menu->tablePadding);
-    uint32_t startx            = menu->borderWidth + tablePaddingX;
-    uint32_t starty            = menu->borderWidth + tablePaddingY;
-    uint32_t rows              = menu->rows;
-    uint32_t cols              = menu->cols;
-    uint32_t wpadding          = menu->wpadding;
-    uint32_t hpadding          = menu->hpadding;
     uint32_t totalTablePadding = tablePaddingX + tablePaddingY;
     uint32_t borderWidthTotal  = menu->borderWidth * 2;
     uint32_t availableWidth    = (totalTablePadding > (width - borderWidthTotal))
                                      ? 0
                                      : width - borderWidthTotal - totalTablePadding;
-    uint32_t cellWidth         = (availableWidth > 0) ? availableWidth / cols : 0;
-    uint32_t cellHeight        = menu->cellHeight;
-    uint32_t count             = menu->keyChords->count;
+
+    grid->startx    = menu->borderWidth + tablePaddingX;
+    grid->starty    = menu->borderWidth + tablePaddingY;
+    grid->cellWidth = (availableWidth > 0 && menu->cols > 0) ? availableWidth / menu->cols : 0;
+    grid->titlew    = (availableWidth > 0) ? availableWidth - (menu->wpadding * 2) : 0;
+}
+
+/* True when every hint cell is already rendered, so compositing them beats
+ * tiling the frame out again. */
+static bool
+cellsAreCached(const Cache* cache, const Vector* cells)
+{
+    assert(cells);
+
+    if (!cache || !cache->enabled) return false;
+
+    vectorForEach(cells, const FrameCell, cell)
+    {
+        if (!cell->header && !cacheContains(cache, &cell->key)) return false;
+    }
+
+    return true;
+}
+
+static bool
+drawGrid(Cairo* cairo, Menu* menu, uint32_t width, uint32_t height, DrawingContext* ctx)
+{
+    assert(cairo), assert(menu), assert(ctx);
+
+    cairo_t*    cr    = cairo->cr;
+    CairoPaint* paint = cairo->paint;
+
+    if (menu->borderWidth * 2 >= width)
+    {
+        errorMsg("Border is larger than menu width.");
+        return false;
+    }
+
+    setPages(menu, height);
+
+    GridGeometry grid;
+    measureGrid(menu, width, &grid);
+
+    uint32_t startx     = grid.startx;
+    uint32_t starty     = grid.starty;
+    uint32_t rows       = menu->rows;
+    uint32_t cols       = menu->cols;
+    uint32_t wpadding   = menu->wpadding;
+    uint32_t hpadding   = menu->hpadding;
+    uint32_t cellWidth  = grid.cellWidth;
+    uint32_t cellHeight = menu->cellHeight;
+    uint32_t count      = menu->keyChords->count;
+    uint32_t titlew     = grid.titlew;
+    double   scale      = getTargetScale(cr);
+
+    cairo_surface_t* chrome    = NULL;
+    cairo_region_t*  damage    = cairo_region_create();
+    Vector           chromeKey = VECTOR_INIT(char);
+    Vector           cells     = VECTOR_INIT(FrameCell);
+    CairoFrame       frame;
+    cairoFrameInit(&frame);
 
     PangoFontDescription* fontDesc = pango_font_description_from_string(menu->font);
     PangoLayout*          layout   = pango_cairo_create_layout(cr);
@@ -789,7 +1830,7 @@ drawGrid(
 
     if (!setSourceRgba(cr, paint, MENU_COLOR_KEY)) goto fail;
 
-    if (menu->debug)
+    if (menu->debug && !traceIsRunning(&menu->trace))
     {
         disassembleGrid(
             startx,
@@ -820,68 +1861,211 @@ drawGrid(
     }
 
     uint32_t titleOffset = 0;
+    size_t   redrawn     = 0;
+
+    makeChromeKey(&chromeKey, paint, menu, width, height, titlew, startx, starty, scale, ctx->ellipsisWidth);
+    chrome = getChrome(
+        cr,
+        paint,
+        cairo->chromeCache,
+        menu,
+        &chromeKey,
+        &titleOffset,
+        width,
+        height,
+        titlew,
+        startx,
+        starty,
+        scale,
+        ctx->ellipsisWidth);
+
+    layoutCells(
+        paint,
+        menu,
+        &cells,
+        startx,
+        starty + titleOffset,
+        cellWidth,
+        cellHeight,
+        scale,
+        ctx->ellipsisWidth);
+
+    frame.chromeHash = cacheKeyHash(&chromeKey);
+    frame.width      = width;
+    frame.height     = height;
+    frame.scale      = scale;
+    frame.valid      = true;
+    vectorForEach(&cells, FrameCell, cell)
+    {
+        CairoCell record = { .rect = cell->rect, .hash = cacheKeyHash(&cell->key) };
+        vectorAppend(&frame.cells, &record);
+    }
+
+    /* Only redraw what changed since this surface was last drawn, plus any
+     * area the backend reported as lost. */
+    frameDamage(&cairo->frame, &frame, damage);
+    if (cairo->pending)
+    {
+        cairo_region_union(damage, cairo->pending);
+        resetRegion(&cairo->pending);
+    }
+
+    if (cairo->presented) frameDamage(cairo->presented, &frame, cairo->damage);
+    else cairo_region_union(cairo->damage, damage);
+
+    if (!cairo_region_is_empty(damage))
+    {
+        cairo_save(cr);
+        clipToRegion(cr, damage);
 
-    if (!drawTitleText(
+        bool result = paintChrome(
             cr,
+            chrome,
             paint,
             menu,
-            &titleOffset,
-            (availableWidth > 0 ? availableWidth - (wpadding * 2) : 0),
+            width,
+            height,
+            titlew,
             startx,
             starty,
-            ctx->ellipsisWidth))
-    {
-        errorMsg("Failed to draw menu title.");
-        goto fail;
-    }
+            ctx->ellipsisWidth);
+        if (!result)
+        {
+            cairo_restore(cr);
+            goto fail;
+        }
 
-    starty += titleOffset;
+        /* Only a frame drawn from scratch is worth spreading over threads,
+         * and not one whose cells were all drawn ahead of time. */
+        cairo_rectangle_int_t full  = { 0, 0, (int)width, (int)height };
+        bool                  tiled = false;
+        if (cairo_region_contains_rectangle(damage, &full) == CAIRO_REGION_OVERLAP_IN &&
+            !cellsAreCached(cairo->cellCache, &cells))
+        {
+            tiled = drawTiles(
+                cr,
+                paint,
+                cairo->cellCache,
+                cairo->tiles,
+                menu,
+                &cells,
+                startx,
+                cellWidth,
+                cellHeight,
+                scale,
+                ctx->ellipsisWidth);
+        }
 
-    if (menuIsGrouped(menu))
-    {
-        drawGroupedColumns(cr, paint, menu, layout, startx, starty, cellWidth, cellHeight, ctx);
-    }
-    else
-    {
-        size_t chordIdx = 0;
-        for (uint32_t i = 0; i < cols; i++)
+        if (tiled)
+        {
+            redrawn = vectorLength(&cells);
+        }
+        else
         {
-            uint32_t x = startx + (i * cellWidth) + wpadding;
-            for (uint32_t j = 0; j < rows; j++)
+            vectorForEach(&cells, FrameCell, cell)
             {
-                if (chordIdx >= menu->keyChords->count) goto done;
-                const KeyChord* keyChord = SPAN_GET(menu->keyChords, const KeyChord, chordIdx++);
-
-                uint32_t y = starty + (j * cellHeight) + hpadding;
-                drawHintText(
-                    cr,
-                    paint,
-                    layout,
-                    menu->delimiter,
-                    keyChord,
-                    cellWidth - (wpadding * 2),
-                    x,
-                    y,
-                    ctx->ellipsisWidth);
+                if (cairo_region_contains_rectangle(damage, &cell->rect) == CAIRO_REGION_OVERLAP_OUT)
+                {
+                    continue;
+                }
+
+                redrawn++;
+                if (cell->header)
+                {
+                    drawHeaderText(
+                        cr,
+                        paint,
+                        cell->keyChord,
+                        menu->headerAlign,
+                        cell->rect.x,
+                        cell->rect.y + hpadding,
+                        cellWidth,
+                        wpadding);
+                }
+                else
+                {
+                    drawHintCell(
+                        cr,
+                        paint,
+                        cairo->cellCache,
+                        menu,
+                        layout,
+                        cell->keyChord,
+                        &cell->key,
+                        cell->rect.x,
+                        cell->rect.y,
+                        cellWidth,
+                        cellHeight,
+                        scale,
+                        ctx->ellipsisWidth);
+                }
             }
         }
+
+        cairo_restore(cr);
     }
 
-done:
+    if (menu->debug && !traceIsRunning(&menu->trace))
+    {
+        debugMsg(
+            true,
+            "Damage: %d rectangle(s), %zu of %zu cells redrawn.",
+            cairo_region_num_rectangles(damage),
+            redrawn,
+            vectorLength(&cells));
+    }
+
+    if (menu->debug && !traceIsRunning(&menu->trace) && cairo->cellCache && cairo->cellCache->enabled)
+    {
+        debugMsg(true, "Cell cache: %zu hits, %zu misses.", cairo->cellCache->hits, cairo->cellCache->misses);
+    }
+
+    cairoFrameCopy(&cairo->frame, &frame);
+    if (cairo->presented) cairoFrameCopy(cairo->presented, &frame);
+
+    if (chrome) cairo_surface_destroy(chrome);
+    cairo_region_destroy(damage);
+    cairoFrameFree(&frame);
+    freeFrameCells(&cells);
+    vectorFree(&chromeKey);
     g_object_unref(layout);
     return true;
 
 fail:
+    /* Whatever was drawn is unknown, start over on the next frame. */
+    cairo->frame.valid = false;
+    if (chrome) cairo_surface_destroy(chrome);
+    cairo_region_destroy(damage);
+    cairoFrameFree(&frame);
+    freeFrameCells(&cells);
+    vectorFree(&chromeKey);
     g_object_unref(layout);
     return false;
 }
 
+void
+cairoInvalidate(Cairo* cairo, const cairo_rectangle_int_t* rect)
+{
+    assert(cairo);
+
+    if (!rect)
+    {
+        cairo->frame.valid = false;
+        return;
+    }
+
+    if (!cairo->pending) cairo->pending = cairo_region_create();
+    cairo_region_union_rectangle(cairo->pending, rect);
+}
+
 bool
 cairoPaint(Cairo* cairo, Menu* menu)
 {
     assert(cairo), assert(menu);
 
-    if (menu->debug) disassembleMenu(menu);
+    resetRegion(&cairo->damage);
+
+    if (menu->debug && !traceIsRunning(&menu->trace)) disassembleMenu(menu);
     if (menu->keyChords->count == 0) return false;
     if (menuIsDelayed(menu)) return true;
 
@@ -893,23 +2077,420 @@ cairoPaint(Cairo* cairo, Menu* menu)
     DrawingContext ctx;
     initDrawingContext(&ctx);
 
-    if (!drawBackground(cairo->cr, cairo->paint, menu, width, height))
+    if (!drawGrid(cairo, menu, width, height, &ctx))
     {
-        errorMsg("Could not draw background.");
+        errorMsg("Could not draw grid.");
         return false;
     }
 
-    if (!drawBorder(cairo->cr, cairo->paint, menu, width, height))
+    return true;
+}
+
+/* The parts of the menu that laying out a level changes. */
+typedef struct
+{
+    Span*       keyChords;
+    const char* title;
+    uint32_t    page;
+    uint32_t    pageCount;
+    uint32_t    rows;
+    uint32_t    cols;
+    uint32_t    cellHeight;
+    uint32_t    titleHeight;
+    uint32_t    headerHeight;
+} MenuLevel;
+
+static void
+saveLevel(const Menu* menu, MenuLevel* level)
+{
+    assert(menu), assert(level);
+
+    level->keyChords    = menu->keyChords;
+    level->title        = menu->title;
+    level->page         = menu->page;
+    level->pageCount    = menu->pageCount;
+    level->rows         = menu->rows;
+    level->cols         = menu->cols;
+    level->cellHeight   = menu->cellHeight;
+    level->titleHeight  = menu->titleHeight;
+    level->headerHeight = menu->headerHeight;
+}
+
+static void
+restoreLevel(Menu* menu, const MenuLevel* level)
+{
+    assert(menu), assert(level);
+
+    menu->keyChords    = level->keyChords;
+    menu->title        = level->title;
+    menu->page         = level->page;
+    menu->pageCount    = level->pageCount;
+    menu->rows         = level->rows;
+    menu->cols         = level->cols;
+    menu->cellHeight   = level->cellHeight;
+    menu->titleHeight  = level->titleHeight;
+    menu->headerHeight = level->headerHeight;
+}
+
+/* Switch to the level 'prefix' opens, the way menuHandlePrefix does. */
+static void
+enterPrefix(Menu* menu, KeyChord* prefix)
+{
+    assert(menu), assert(prefix);
+
+    menu->keyChords = &prefix->keyChords;
+    menu->page      = 0;
+    if (propIsSet(prefix, KC_PROP_TITLE)) menu->title = propStringConst(prefix, KC_PROP_TITLE)->data;
+}
+
+/* Lay out the current level for a window 'width' wide the way drawGrid
+ * would and fill 'cells' with its cells. Returns false if drawGrid wouldn't
+ * draw it, a level it can't draw isn't worth caching. */
+static bool
+layoutLevel(
+    Cairo*          cairo,
+    Menu*           menu,
+    uint32_t        width,
+    uint32_t        maxHeight,
+    uint32_t*       height,
+    GridGeometry*   grid,
+    DrawingContext* ctx,
+    Vector*         cells)
+{
+    assert(cairo), assert(menu), assert(height), assert(grid), assert(ctx), assert(cells);
+
+    cairo_t* cr    = cairo->cr;
+    double   scale = getTargetScale(cr);
+
+    *height = cairoHeight(menu, cairo_surface_reference(cairo->surface), maxHeight);
+    setPages(menu, *height);
+    measureGrid(menu, width, grid);
+    initDrawingContext(ctx);
+
+    PangoFontDescription* fontDesc = pango_font_description_from_string(menu->font);
+    PangoLayout*          layout   = pango_cairo_create_layout(cr);
+
+    pango_layout_set_font_description(layout, fontDesc);
+    pango_font_description_free(fontDesc);
+    initEllipsisIfNeeded(cr, layout, ctx);
+    g_object_unref(layout);
+
+    if ((menu->wpadding * 2) >= grid->cellWidth) return false;
+    if ((uint32_t)ctx->ellipsisWidth > grid->cellWidth - (menu->wpadding * 2))
+    {
+        ctx->ellipsisWidth  = 0;
+        ctx->ellipsisHeight = -1;
+    }
+
+    /* Cell keys don't depend on where the cells go, so the title offset
+     * doesn't matter here. */
+    layoutCells(
+        cairo->paint,
+        menu,
+        cells,
+        grid->startx,
+        grid->starty,
+        grid->cellWidth,
+        menu->cellHeight,
+        scale,
+        ctx->ellipsisWidth);
+    return true;
+}
+
+/* Mark the cached cells of the current level as just used, so rendering
+ * other levels evicts them last. Returns how many of them are cached. The
+ * layout is stored in 'menu' like drawGrid does, callers restore it. */
+static size_t
+pinLevel(Cairo* cairo, Menu* menu, uint32_t width, uint32_t maxHeight)
+{
+    assert(cairo), assert(menu);
+
+    uint32_t       height;
+    size_t         pinned = 0;
+    Vector         cells  = VECTOR_INIT(FrameCell);
+    GridGeometry   grid;
+    DrawingContext ctx;
+
+    if (layoutLevel(cairo, menu, width, maxHeight, &height, &grid, &ctx, &cells))
+    {
+        vectorForEach(&cells, FrameCell, cell)
+        {
+            if (!cell->header && cacheTouch(cairo->cellCache, &cell->key)) pinned++;
+        }
+    }
+
+    freeFrameCells(&cells);
+    return pinned;
+}
+
+/* Lay out the current level and render its cells, and its chrome if asked
+ * to, into the caches. A non-NULL 'budget' caps how many cells are inserted
+ * and is lowered by each one. Returns how many surfaces had to be rendered. */
+static size_t
+prerenderLevel(Cairo* cairo, Menu* menu, uint32_t width, uint32_t maxHeight, bool withChrome, size_t* budget)
+{
+    assert(cairo), assert(menu);
+
+    cairo_t*       cr        = cairo->cr;
+    CairoPaint*    paint     = cairo->paint;
+    double         scale     = getTargetScale(cr);
+    size_t         rendered  = 0;
+    uint32_t       height    = 0;
+    Vector         chromeKey = VECTOR_INIT(char);
+    Vector         cells     = VECTOR_INIT(FrameCell);
+    GridGeometry   grid;
+    DrawingContext ctx;
+
+    if (!layoutLevel(cairo, menu, width, maxHeight, &height, &grid, &ctx, &cells)) goto done;
+
+    makeChromeKey(
+        &chromeKey,
+        paint,
+        menu,
+        width,
+        height,
+        grid.titlew,
+        grid.startx,
+        grid.starty,
+        scale,
+        ctx.ellipsisWidth);
+    if (withChrome && cairo->chromeCache && !cacheContains(cairo->chromeCache, &chromeKey))
     {
-        errorMsg("Could not draw border.");
-        return false;
+        cairo_surface_t* chrome = renderChrome(
+            cr,
+            paint,
+            menu,
+            width,
+            height,
+            grid.titlew,
+            grid.startx,
+            grid.starty,
+            scale,
+            ctx.ellipsisWidth);
+        if (chrome)
+        {
+            cacheInsert(cairo->chromeCache, &chromeKey, chrome);
+            cairo_surface_destroy(chrome);
+            rendered++;
+        }
     }
 
-    if (!drawGrid(cairo->cr, cairo->paint, menu, width, height, &ctx))
+    vectorForEach(&cells, FrameCell, cell)
     {
-        errorMsg("Could not draw grid.");
+        if (budget && *budget == 0) break;
+        if (cell->header || cacheContains(cairo->cellCache, &cell->key)) continue;
+
+        cairo_surface_t* surface = renderHintCell(
+            cr,
+            paint,
+            menu,
+            cell->keyChord,
+            grid.cellWidth,
+            menu->cellHeight,
+            scale,
+            ctx.ellipsisWidth);
+        if (!surface) continue;
+
+        cacheInsert(cairo->cellCache, &cell->key, surface);
+        cairo_surface_destroy(surface);
+        rendered++;
+        if (budget) (*budget)--;
+    }
+
+done:
+    freeFrameCells(&cells);
+    vectorFree(&chromeKey);
+    return rendered;
+}
+
+/* Render the levels the most used prefixes of the current level open into
+ * the caches, for a window 'width' wide, so that pressing one composites its
+ * frame instead of shaping text. Backends call this once per level when
+ * they have nothing else to do. The menu is left as it was. */
+void
+cairoPrefetch(Cairo* cairo, Menu* menu, uint32_t width, uint32_t maxHeight)
+{
+    assert(cairo), assert(menu);
+
+    if (!menu->usage.enabled || !width) return;
+    if (!cairo->cellCache || !cairo->cellCache->enabled) return;
+
+    KeyChord* prefixes[MENU_PREFETCH_COUNT];
+    size_t    count = menuPredictPrefixes(menu, prefixes);
+    if (!count) return;
+
+    MenuLevel level;
+    saveLevel(menu, &level);
+
+    /* The shown level's cells come first: pin them and only fill the room
+     * left around them, or the next frame would shape them all again. */
+    size_t room = cairo->cellCache->capacity - pinLevel(cairo, menu, width, maxHeight);
+    restoreLevel(menu, &level);
+
+    for (size_t i = 0; i < count && room; i++)
+    {
+        traceBegin(&menu->trace, TRACE_PREFETCH);
+        enterPrefix(menu, prefixes[i]);
+        size_t rendered = prerenderLevel(cairo, menu, width, maxHeight, true, &room);
+        traceEnd(&menu->trace, TRACE_PREFETCH, rendered);
+        restoreLevel(menu, &level);
+
+        debugMsg(
+            menu->debug,
+            "Prefetched '%s': %zu surface(s) rendered.",
+            prefixes[i]->key.repr.data,
+            rendered);
+    }
+}
+
+/* Render the level the delay is hiding, then every level its prefixes open
+ * while the cell cache has room for them, until cancelled. Only the level
+ * shown first gets its chrome, the others would push it out of the chrome
+ * cache. */
+static void*
+speculate(void* data)
+{
+    assert(data);
+
+    CairoSpeculation* speculation = data;
+    Menu*             menu        = &speculation->menu;
+    Cairo             cairo       = {
+        .cr          = speculation->cr,
+        .surface     = speculation->target,
+        .paint       = speculation->paint,
+        .cellCache   = &speculation->cellCache,
+        .chromeCache = &speculation->chromeCache,
+        .scale       = 1,
+    };
+
+    size_t used = prerenderLevel(&cairo, menu, speculation->width, speculation->maxHeight, true, NULL);
+
+    MenuLevel level;
+    saveLevel(menu, &level);
+
+    spanForEach(level.keyChords, KeyChord, prefix)
+    {
+        if (atomic_load(&speculation->cancel)) break;
+        if (prefix->keyChords.count == 0 || propIsSet(prefix, KC_PROP_GOTO)) continue;
+        if (used + prefix->keyChords.count > speculation->cellCache.capacity) continue;
+
+        enterPrefix(menu, prefix);
+        used += prerenderLevel(&cairo, menu, speculation->width, speculation->maxHeight, false, NULL);
+        restoreLevel(menu, &level);
+    }
+
+    speculation->rendered = used;
+    return NULL;
+}
+
+/* Join the thread, if one is running, and move what it rendered into the
+ * caches of 'cairo'. A NULL 'cairo' throws it away. */
+void
+cairoSpeculationFinish(CairoSpeculation* speculation, Cairo* cairo)
+{
+    assert(speculation);
+
+    if (!speculation->started) return;
+
+    atomic_store(&speculation->cancel, true);
+    pthread_join(speculation->thread, NULL);
+    speculation->started = false;
+
+    if (cairo && cairo->cellCache) cacheMerge(cairo->cellCache, &speculation->cellCache);
+    if (cairo && cairo->chromeCache) cacheMerge(cairo->chromeCache, &speculation->chromeCache);
+
+    debugMsg(
+        speculation->menu.debug,
+        "Rendered %zu surface(s) ahead of time during the delay.",
+        speculation->rendered);
+
+    cacheFree(&speculation->cellCache);
+    cacheFree(&speculation->chromeCache);
+    cairo_destroy(speculation->cr);
+    cairo_surface_destroy(speculation->target);
+}
+
+/* While the menu delay lasts, render the level it will show and the levels
+ * its prefixes open on a thread of their own. The thread works on a copy of
+ * the menu and an image surface with the same scale and font options as
+ * 'cairo', and fills private caches. Returns true if it was started. */
+bool
+cairoSpeculationStart(CairoSpeculation* speculation, Cairo* cairo, Menu* menu, uint32_t width, uint32_t maxHeight)
+{
+    assert(speculation), assert(cairo), assert(menu);
+
+    if (speculation->started || !width || !menuIsDelayed(menu)) return false;
+    if (!cairo->cellCache || !cairo->cellCache->enabled) return false;
+
+    double scale        = getTargetScale(cairo->cr);
+    speculation->target = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    if (cairo_surface_status(speculation->target) != CAIRO_STATUS_SUCCESS)
+    {
+        cairo_surface_destroy(speculation->target);
+        return false;
+    }
+    cairo_surface_set_device_scale(speculation->target, scale, scale);
+
+    speculation->cr = cairo_create(speculation->target);
+    copyFontOptions(cairo->cr, speculation->cr, true);
+
+    speculation->menu      = *menu;
+    speculation->paint     = cairo->paint;
+    speculation->width     = width;
+    speculation->maxHeight = maxHeight;
+    speculation->rendered  = 0;
+    atomic_init(&speculation->cancel, false);
+    cacheInit(&speculation->cellCache, cairo->cellCache->capacity, true);
+    cacheInit(&speculation->chromeCache, 1, true);
+
+    speculation->started = pthread_create(&speculation->thread, NULL, speculate, speculation) == 0;
+    if (!speculation->started)
+    {
+        cacheFree(&speculation->cellCache);
+        cacheFree(&speculation->chromeCache);
+        cairo_destroy(speculation->cr);
+        cairo_surface_destroy(speculation->target);
         return false;
     }
 
+    debugMsg(menu->debug, "Rendering ahead of time during the delay.");
     return true;
 }
+
+void
+cairoTilesFree(CairoTiles* tiles)
+{
+    assert(tiles);
+
+    if (!tiles->threads) return;
+
+    pthread_mutex_lock(&tiles->lock);
+    tiles->stop = true;
+    pthread_cond_broadcast(&tiles->queued);
+    pthread_mutex_unlock(&tiles->lock);
+
+    for (uint32_t i = 0; i < tiles->count; i++)
+    {
+        pthread_join(tiles->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&tiles->finished);
+    pthread_cond_destroy(&tiles->queued);
+    pthread_mutex_destroy(&tiles->lock);
+    free(tiles->threads);
+    cairoTilesInit(tiles);
+}
+
+void
+cairoTilesInit(CairoTiles* tiles)
+{
+    assert(tiles);
+
+    tiles->threads   = NULL;
+    tiles->jobs      = NULL;
+    tiles->count     = 0;
+    tiles->jobCount  = 0;
+    tiles->next      = 0;
+    tiles->remaining = 0;
+    tiles->stop      = false;
+}
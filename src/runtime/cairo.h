@@ -2,9 +2,13 @@
 #define WK_RUNTIME_CAIRO_H_
 
 #include <cairo.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "common/menu.h"
 
+#include "cache.h"
+
 typedef struct
 {
     float r, g, b, a;
@@ -26,20 +30,88 @@ typedef struct
     const char* headerFont;
 } CairoPaint;
 
+/* Position and content hash of one cell as it was drawn */
+typedef struct
+{
+    cairo_rectangle_int_t rect;
+    uint64_t              hash;
+} CairoCell;
+
+/* Layout of a drawn frame, used to find what changed on the next one */
+typedef struct
+{
+    Vector   cells;
+    uint64_t chromeHash;
+    uint32_t width;
+    uint32_t height;
+    double   scale;
+    bool     valid;
+} CairoFrame;
+
+/* Threads that render the tiles of a frame. They are started on the first
+ * tiled frame and kept until the window goes away, see drawTiles. */
+typedef struct
+{
+    pthread_t*         threads;
+    struct RenderTile* jobs;
+    pthread_mutex_t    lock;
+    pthread_cond_t     queued;
+    pthread_cond_t     finished;
+    uint32_t           count;
+    uint32_t           jobCount;
+    uint32_t           next;
+    uint32_t           remaining;
+    bool               stop;
+} CairoTiles;
+
 typedef struct
 {
     cairo_t*         cr;
     cairo_surface_t* surface;
     CairoPaint*      paint;
+    Cache*           cellCache;
+    Cache*           chromeCache;
+    CairoTiles*      tiles;
+    CairoFrame       frame;
+    CairoFrame*      presented;
+    cairo_region_t*  damage;
+    cairo_region_t*  pending;
     double           scale;
     uint32_t         width;
     uint32_t         height;
 } Cairo;
 
+/* Levels rendered on a thread of their own while the menu delay keeps the
+ * menu hidden, see cairoSpeculationStart. */
+typedef struct
+{
+    pthread_t        thread;
+    Menu             menu;
+    cairo_surface_t* target;
+    cairo_t*         cr;
+    CairoPaint*      paint;
+    Cache            cellCache;
+    Cache            chromeCache;
+    uint32_t         width;
+    uint32_t         maxHeight;
+    size_t           rendered;
+    atomic_bool      cancel;
+    bool             started;
+} CairoSpeculation;
+
 bool     cairoCreateForSurface(Cairo* cairo, cairo_surface_t* surface);
 void     cairoDestroy(Cairo* cairo);
+void     cairoFrameCopy(CairoFrame* to, const CairoFrame* from);
+void     cairoFrameFree(CairoFrame* frame);
+void     cairoFrameInit(CairoFrame* frame);
 uint32_t cairoHeight(Menu* menu, cairo_surface_t* surface, uint32_t maxHeight);
+void     cairoInvalidate(Cairo* cairo, const cairo_rectangle_int_t* rect);
 void     cairoPaintInit(Menu* menu, CairoPaint* paint);
 bool     cairoPaint(Cairo* cairo, Menu* menu);
+void     cairoPrefetch(Cairo* cairo, Menu* menu, uint32_t width, uint32_t maxHeight);
+void     cairoSpeculationFinish(CairoSpeculation* speculation, Cairo* cairo);
+bool     cairoSpeculationStart(CairoSpeculation* speculation, Cairo* cairo, Menu* menu, uint32_t width, uint32_t maxHeight);
+void     cairoTilesFree(CairoTiles* tiles);
+void     cairoTilesInit(CairoTiles* tiles);
 
 #endif /* WK_RUNTIME_CAIRO_H_ */
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* common includes */
+#include "common/memory.h"
+
+/* local includes */
+#include "key_table.h"
+
+static size_t
+keyTableSlot(uint32_t keycode, uint32_t state, uint32_t group)
+{
+    uint32_t hash = keycode * 0x9e3779b1u;
+    hash ^= state + 0x7f4a7c15u + (hash << 6) + (hash >> 2);
+    hash ^= group + 0x7f4a7c15u + (hash << 6) + (hash >> 2);
+    return hash & (KEY_TABLE_CAPACITY - 1);
+}
+
+static bool
+keyTableEntryMatches(const KeyTableEntry* entry, uint32_t keycode, uint32_t state, uint32_t group)
+{
+    assert(entry);
+
+    return entry->keycode == keycode && entry->state == state && entry->group == group;
+}
+
+void
+keyTableClear(KeyTable* table)
+{
+    assert(table);
+
+    if (table->entries) memset(table->entries, 0, sizeof(KeyTableEntry) * KEY_TABLE_CAPACITY);
+    table->count = 0;
+}
+
+void
+keyTableFree(KeyTable* table)
+{
+    assert(table);
+
+    free(table->entries);
+    keyTableInit(table);
+}
+
+void
+keyTableInit(KeyTable* table)
+{
+    assert(table);
+
+    table->entries = NULL;
+    table->count   = 0;
+    table->hits    = 0;
+    table->misses  = 0;
+}
+
+void
+keyTableInsert(KeyTable* table, const KeyTableEntry* entry)
+{
+    assert(table), assert(entry);
+
+    if (!table->entries)
+    {
+        table->entries = ALLOCATE(KeyTableEntry, KEY_TABLE_CAPACITY);
+        keyTableClear(table);
+    }
+
+    /* Keep probes short, a full table just starts over. */
+    if (table->count >= (KEY_TABLE_CAPACITY / 4) * 3) keyTableClear(table);
+
+    size_t slot = keyTableSlot(entry->keycode, entry->state, entry->group);
+    while (table->entries[slot].used)
+    {
+        if (keyTableEntryMatches(&table->entries[slot], entry->keycode, entry->state, entry->group))
+        {
+            table->count--;
+            break;
+        }
+        slot = (slot + 1) & (KEY_TABLE_CAPACITY - 1);
+    }
+
+    table->entries[slot]      = *entry;
+    table->entries[slot].used = true;
+    table->count++;
+}
+
+const KeyTableEntry*
+keyTableLookup(KeyTable* table, uint32_t keycode, uint32_t state, uint32_t group)
+{
+    assert(table);
+
+    if (!table->entries)
+    {
+        table->misses++;
+        return NULL;
+    }
+
+    size_t slot = keyTableSlot(keycode, state, group);
+    while (table->entries[slot].used)
+    {
+        const KeyTableEntry* entry = &table->entries[slot];
+        if (keyTableEntryMatches(entry, keycode, state, group))
+        {
+            table->hits++;
+            return entry;
+        }
+        slot = (slot + 1) & (KEY_TABLE_CAPACITY - 1);
+    }
+
+    table->misses++;
+    return NULL;
+}
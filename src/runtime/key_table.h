@@ -0,0 +1,47 @@
+#ifndef WK_RUNTIME_KEY_TABLE_H_
+#define WK_RUNTIME_KEY_TABLE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* common includes */
+#include "common/special_key.h"
+
+#define KEY_TABLE_CAPACITY 256
+#define KEY_TABLE_REPR_SIZE 128
+
+/* The translation of one keycode under one keyboard state. 'state' and
+ * 'group' are whatever the backend's translation depends on. The modifiers
+ * themselves are not stored, only whether Shift went into the repr, so the
+ * backend applies the modifiers of the event at hand. */
+typedef struct
+{
+    uint32_t   keycode;
+    uint32_t   state;
+    uint32_t   group;
+    uint32_t   keysym;
+    SpecialKey special;
+    bool       shiftConsumed;
+    bool       used;
+    size_t     reprLength;
+    char       repr[KEY_TABLE_REPR_SIZE];
+} KeyTableEntry;
+
+/* Translations filled in as keys are pressed and dropped whenever the
+ * keymap or layout changes. */
+typedef struct
+{
+    KeyTableEntry* entries;
+    size_t         count;
+    size_t         hits;
+    size_t         misses;
+} KeyTable;
+
+void                 keyTableClear(KeyTable* table);
+void                 keyTableFree(KeyTable* table);
+void                 keyTableInit(KeyTable* table);
+void                 keyTableInsert(KeyTable* table, const KeyTableEntry* entry);
+const KeyTableEntry* keyTableLookup(KeyTable* table, uint32_t keycode, uint32_t state, uint32_t group);
+
+#endif /* WK_RUNTIME_KEY_TABLE_H_ */
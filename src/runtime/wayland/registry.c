@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -16,10 +17,12 @@
 
 /* common includes */
 #include "common/common.h"
+#include "common/debug.h"
 #include "common/menu.h"
 
 /* local includes */
 #include "fractional-scale-v1.h"
+#include "presentation-time.h"
 #include "registry.h"
 #include "wayland.h"
 #include "wlr-layer-shell-unstable-v1.h"
@@ -60,27 +63,58 @@ struct wl_shm_listener shmListener = {
     .format = shmFormat,
 };
 
+static void*
+compileKeymap(void* data)
+{
+    assert(data);
+
+    Xkb* xkb = data;
+
+    xkb->compile.keymap = xkb_keymap_new_from_string(
+        xkb->context,
+        xkb->compile.map,
+        XKB_KEYMAP_FORMAT_TEXT_V1,
+        0);
+    munmap(xkb->compile.map, xkb->compile.size);
+    xkb->compile.map = NULL;
+
+    return NULL;
+}
+
 static void
-keyboardHandleKeymap(void* data, struct wl_keyboard* keyboard, uint32_t format, int fd, uint32_t size)
+updateModifiers(Input* input)
 {
-    (void)keyboard;
-    Input* input = data;
+    assert(input);
 
-    if (!data) goto exit;
+    Xkb* xkb = &input->xkb;
+    xkb_state_update_mask(
+        xkb->state,
+        xkb->depressedMods,
+        xkb->latchedMods,
+        xkb->lockedMods,
+        0,
+        0,
+        xkb->group);
 
-    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) goto exit;
+    xkb_mod_mask_t mask = xkb_state_serialize_mods(
+        xkb->state,
+        XKB_STATE_MODS_DEPRESSED | XKB_STATE_MODS_LATCHED);
 
-    char* mapstr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (mapstr == MAP_FAILED) goto exit;
+    input->modifiers = 0;
+    for (uint32_t i = 0; i < MASK_LAST; i++)
+    {
+        if (mask & xkb->masks[i]) input->modifiers |= WK_XKB_MODS[i];
+    }
+}
 
-    struct xkb_keymap* keymap = xkb_keymap_new_from_string(
-        input->xkb.context,
-        mapstr,
-        XKB_KEYMAP_FORMAT_TEXT_V1,
-        0);
-    munmap(mapstr, size);
-    close(fd);
+static void
+installKeymap(Input* input)
+{
+    assert(input);
 
+    Xkb*               xkb    = &input->xkb;
+    struct xkb_keymap* keymap = xkb->compile.keymap;
+    xkb->compile.keymap       = NULL;
     if (!keymap)
     {
         errorMsg("Failed to compile keymap.");
@@ -95,16 +129,77 @@ keyboardHandleKeymap(void* data, struct wl_keyboard* keyboard, uint32_t format,
         return;
     }
 
-    xkb_keymap_unref(input->xkb.keymap);
-    xkb_state_unref(input->xkb.state);
-    input->xkb.keymap = keymap;
-    input->xkb.state  = state;
+    xkb_keymap_unref(xkb->keymap);
+    xkb_state_unref(xkb->state);
+    xkb->keymap     = keymap;
+    xkb->state      = state;
+    xkb->keymapHash = xkb->compile.hash;
+    keyTableClear(&input->keyTable);
 
     for (uint32_t i = 0; i < MASK_LAST; i++)
     {
-        input->xkb.masks[i] = 1 << xkb_keymap_mod_get_index(input->xkb.keymap, WK_XKB_MASK_NAMES[i]);
+        xkb->masks[i] = 1 << xkb_keymap_mod_get_index(xkb->keymap, WK_XKB_MASK_NAMES[i]);
     }
 
+    /* Modifiers may have arrived while the keymap was compiling. */
+    updateModifiers(input);
+}
+
+/* Wait for a keymap compiled in the background and install it. Anything that
+ * reads the keymap or state must call this first. */
+static void
+syncKeymap(Input* input)
+{
+    assert(input);
+
+    if (!input->xkb.compile.running) return;
+
+    pthread_join(input->xkb.compile.thread, NULL);
+    input->xkb.compile.running = false;
+    installKeymap(input);
+}
+
+static void
+keyboardHandleKeymap(void* data, struct wl_keyboard* keyboard, uint32_t format, int fd, uint32_t size)
+{
+    (void)keyboard;
+    Input* input = data;
+
+    if (!data) goto exit;
+
+    if (format != WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1) goto exit;
+
+    char* mapstr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapstr == MAP_FAILED) return;
+
+    syncKeymap(input);
+
+    /* Compositors resend the keymap on focus and seat changes, usually
+     * unchanged. Keep the compiled one when the bytes match. */
+    uint64_t hash = hashBytes(FNV_OFFSET_BASIS, mapstr, size);
+    if (input->xkb.keymap && hash == input->xkb.keymapHash)
+    {
+        debugMsg(debug, "Keymap unchanged, skipping compilation.");
+        munmap(mapstr, size);
+        return;
+    }
+
+    /* Compile off the main thread so surface setup and the first frame are
+     * not held up by xkbcommon. The mapping is released by the worker. */
+    input->xkb.compile.map    = mapstr;
+    input->xkb.compile.size   = size;
+    input->xkb.compile.hash   = hash;
+    input->xkb.compile.keymap = NULL;
+    if (pthread_create(&input->xkb.compile.thread, NULL, compileKeymap, &input->xkb) != 0)
+    {
+        warnMsg("Could not start keymap thread, compiling inline.");
+        compileKeymap(&input->xkb);
+        installKeymap(input);
+        return;
+    }
+
+    input->xkb.compile.running = true;
     return;
 
 exit:
@@ -150,15 +245,30 @@ keyboardHandleLeave(
 }
 
 static void
-press(Input* input, xkb_keysym_t keysym, uint32_t key, enum wl_keyboard_key_state state)
+press(Input* input, xkb_keysym_t keysym, uint32_t key, enum wl_keyboard_key_state state, uint32_t time)
 {
     if (state == WL_KEYBOARD_KEY_STATE_PRESSED)
     {
-        input->keysym     = keysym;
-        input->code       = key + 8;
-        input->keyPending = true;
+        input->keysym = keysym;
+        input->code   = key + 8;
+
+        /* Keys pressed faster than frames are drawn wait here, so the event
+         * loop handles all of them before drawing once. */
+        if (keysym != XKB_KEY_NoSymbol && input->pendingKeyCount < KEY_QUEUE_SIZE)
+        {
+            input->pendingKeys[input->pendingKeyCount++] = (PendingKey){
+                .keysym        = keysym,
+                .code          = input->code,
+                .modifiers     = input->modifiers,
+                .depressedMods = input->xkb.depressedMods,
+                .latchedMods   = input->xkb.latchedMods,
+                .lockedMods    = input->xkb.lockedMods,
+                .group         = input->xkb.group,
+                .time          = time,
+            };
+        }
     }
-    else if (!input->keyPending)
+    else if (!input->pendingKeyCount)
     {
         input->keysym = XKB_KEY_NoSymbol;
         input->code   = 0;
@@ -176,14 +286,15 @@ keyboardHandleKey(
     uint32_t            key,
     uint32_t            stateW)
 {
-    (void)keyboard, (void)serial, (void)time;
+    (void)keyboard, (void)serial;
     Input*                     input = data;
     enum wl_keyboard_key_state state = stateW;
 
+    syncKeymap(input);
     if (!input->xkb.state) return;
 
     xkb_keysym_t keysym = xkb_state_key_get_one_sym(input->xkb.state, key + 8);
-    press(input, keysym, key, state);
+    press(input, keysym, key, state, time);
 
     if (state == WL_KEYBOARD_KEY_STATE_PRESSED &&
         xkb_keymap_key_repeats(input->xkb.keymap, input->code))
@@ -224,22 +335,13 @@ keyboardHandleModifiers(
     Input* input             = data;
     input->xkb.group         = group;
     input->xkb.depressedMods = depressedMods;
-    input->xkb.latchedMods   = depressedMods;
+    input->xkb.latchedMods   = latchedMods;
     input->xkb.lockedMods    = lockedMods;
 
-    if (!input->xkb.keymap) return;
-
-    xkb_state_update_mask(input->xkb.state, depressedMods, latchedMods, lockedMods, 0, 0, group);
-
-    xkb_mod_mask_t mask = xkb_state_serialize_mods(
-        input->xkb.state,
-        XKB_STATE_MODS_DEPRESSED | XKB_STATE_MODS_LATCHED);
+    /* Leave a pending keymap alone, it picks these up once installed. */
+    if (input->xkb.compile.running || !input->xkb.keymap) return;
 
-    input->modifiers = 0;
-    for (uint32_t i = 0; i < MASK_LAST; i++)
-    {
-        if (mask & input->xkb.masks[i]) input->modifiers |= WK_XKB_MODS[i];
-    }
+    updateModifiers(input);
 }
 
 static void
@@ -653,6 +755,18 @@ static const struct wl_output_listener outputListener = {
     .scale       = displayHandleScale,
 };
 
+static void
+presentationHandleClockId(void* data, struct wp_presentation* presentation, uint32_t clock)
+{
+    (void)presentation;
+    Wayland* wayland           = data;
+    wayland->presentationClock = clock;
+}
+
+static const struct wp_presentation_listener presentationListener = {
+    .clock_id = presentationHandleClockId,
+};
+
 static void
 registryHandleGlobal(
     void*               data,
@@ -698,6 +812,11 @@ registryHandleGlobal(
             &wp_fractional_scale_manager_v1_interface,
             1);
     }
+    else if (strcmp(interface, wp_presentation_interface.name) == 0)
+    {
+        wayland->presentation = wl_registry_bind(registry, id, &wp_presentation_interface, 1);
+        wp_presentation_add_listener(wayland->presentation, &presentationListener, data);
+    }
 }
 
 static void
@@ -719,6 +838,10 @@ waylandRepeat(Wayland* wayland)
     uint64_t exp;
     if (read(wayland->fds.repeat, &exp, sizeof(exp)) != sizeof(exp)) return;
 
+    /* Repeats have no event time, stamp them like the compositor would. */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
     if (wayland->input.notify.key)
     {
         wayland->input.notify.key(
@@ -730,7 +853,8 @@ waylandRepeat(Wayland* wayland)
         &wayland->input,
         wayland->input.repeatKeysym,
         wayland->input.repeatKey,
-        WL_KEYBOARD_KEY_STATE_PRESSED);
+        WL_KEYBOARD_KEY_STATE_PRESSED,
+        (uint32_t)((uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000));
 }
 
 void
@@ -741,11 +865,14 @@ waylandRegistryDestroy(Wayland* wayland)
     if (wayland->shm) wl_shm_destroy(wayland->shm);
     if (wayland->layerShell) zwlr_layer_shell_v1_destroy(wayland->layerShell);
     if (wayland->fractionalScaleManager) wp_fractional_scale_manager_v1_destroy(wayland->fractionalScaleManager);
+    if (wayland->presentation) wp_presentation_destroy(wayland->presentation);
     if (wayland->compositor) wl_compositor_destroy(wayland->compositor);
     if (wayland->registry) wl_registry_destroy(wayland->registry);
 
+    syncKeymap(&wayland->input);
     xkb_keymap_unref(wayland->input.xkb.keymap);
     xkb_state_unref(wayland->input.xkb.state);
+    keyTableFree(&wayland->input.keyTable);
 }
 
 bool
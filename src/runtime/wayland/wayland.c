@@ -15,7 +15,9 @@
 /* common includes */
 #include "common/common.h"
 #include "common/debug.h"
+#include "common/latency.h"
 #include "common/menu.h"
+#include "common/trace.h"
 
 /* runtime includes */
 #include "common/string.h"
@@ -146,6 +148,41 @@ scheduleWindowsRenderIfDirty(Menu* menu, Wayland* wayland)
     menu->dirty = false;
 }
 
+/* Once every window shows the current level, or while the delay keeps it
+ * hidden, use the wait for the next key to draw what it most likely opens. */
+static void
+prefetchWindows(Menu* menu, Wayland* wayland)
+{
+    assert(menu), assert(wayland);
+
+    WaylandWindow* window;
+    wl_list_for_each(window, &wayland->windows, link)
+    {
+        if (window->renderPending || (window->framecb && !menuIsDelayed(menu))) continue;
+        windowPrefetch(window, menu);
+    }
+}
+
+/* Arm the delay timer for whatever is left of the menu delay or the +keep
+ * deadline, so the event loop can block until either is due instead of
+ * polling for it. */
+static void
+armDelayTimer(Wayland* wayland, Menu* menu)
+{
+    assert(wayland), assert(menu);
+
+    uint32_t remaining = menuWaitRemaining(menu);
+    if (!remaining) return;
+
+    struct itimerspec its = {
+        .it_interval.tv_sec  = 0,
+        .it_interval.tv_nsec = 0,
+        .it_value.tv_sec     = remaining / 1000,
+        .it_value.tv_nsec    = (remaining % 1000) * 1000000,
+    };
+    timerfd_settime(wayland->fds.delay, 0, &its, NULL);
+}
+
 static bool
 checkEvents(Wayland* wayland, int wait)
 {
@@ -155,9 +192,11 @@ checkEvents(Wayland* wayland, int wait)
 
     if (wl_display_flush(wayland->display) < 0 && errno != EAGAIN) return false;
 
+    /* A signal only cuts the wait short, e.g. SIGUSR1 for the trace. Events
+     * and keys still pending are handled on the next pass. */
     struct epoll_event ep[16];
     int                num = epoll_wait(efd, ep, 16, wait);
-    if (num < 0) return false;
+    if (num < 0) return errno == EINTR;
 
     for (int i = 0; i < num; i++)
     {
@@ -173,21 +212,63 @@ checkEvents(Wayland* wayland, int wait)
         {
             waylandRepeat(wayland);
         }
+        else if (ep[i].data.ptr == &wayland->fds.delay)
+        {
+            /* Nothing to do but drain it, the next dispatch draws the
+             * frame the delay was hiding. */
+            uint64_t expirations;
+            if (read(wayland->fds.delay, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+            {
+                return false;
+            }
+        }
     }
 
-    if (wait == 0) usleep(1000);
-
     return true;
 }
 
+/* Follow the pidfd of the running sync command, or the runner's socket when
+ * the runner has it. It changes as the pipeline advances and a closed fd
+ * leaves the epoll set on its own, so it is registered afresh before each
+ * wait. */
+static void
+watchCommand(Wayland* wayland, Menu* menu)
+{
+    assert(wayland), assert(menu);
+
+    if (wayland->fds.command >= 0) epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.command, NULL);
+
+    wayland->fds.command = menuCommandFd(menu);
+    if (wayland->fds.command < 0) return;
+
+    struct epoll_event ep;
+    ep.events   = EPOLLIN;
+    ep.data.ptr = &wayland->fds.command;
+    epoll_ctl(efd, EPOLL_CTL_ADD, wayland->fds.command, &ep);
+}
+
+/* Wait for and dispatch the next events. Windows are drawn by the caller
+ * once the keys that came in with them are handled. */
 static bool
-render(Menu* menu, Wayland* wayland)
+dispatch(Menu* menu, Wayland* wayland)
 {
     assert(menu), assert(wayland);
 
+    /* Windows are not redrawn while the delay lasts, the first real frame
+     * is requested once it runs out. */
+    if (wayland->delayed && !menuIsDelayed(menu)) menu->dirty = true;
+    wayland->delayed = menuIsDelayed(menu);
+
     scheduleWindowsRenderIfDirty(menu, wayland);
-    if (!checkEvents(wayland, menuIsDelayed(menu) ? 0 : -1)) return false;
-    renderWindowsIfPending(menu, wayland);
+    armDelayTimer(wayland, menu);
+    watchCommand(wayland, menu);
+
+    traceBegin(&menu->trace, TRACE_WAIT);
+    bool ok = checkEvents(wayland, -1);
+    traceEnd(&menu->trace, TRACE_WAIT, ok);
+    if (!ok) return false;
+
+    menuContinueCommands(menu);
 
     return true;
 }
@@ -326,21 +407,14 @@ handleMysteryKeypress(Menu* menu, xkb_keysym_t keysym, char* reprBuf, size_t rep
     return (size_t)len;
 }
 
-static size_t
-setKeyRepr(
-    Wayland*      wayland,
-    Menu*         menu,
-    Key*          key,
-    xkb_keysym_t* outKeysym,
-    char*         reprBuf,
-    size_t        reprBufSize)
+/* Translate the pending key into the entry the key table keeps for it. */
+static void
+translateKey(Wayland* wayland, Menu* menu, KeyTableEntry* entry)
 {
-    assert(wayland), assert(menu), assert(key), assert(outKeysym), assert(reprBuf);
-    assert(reprBufSize > 0);
+    assert(wayland), assert(menu), assert(entry);
 
     Xkb*         xkb     = &wayland->input.xkb;
     uint32_t     keycode = wayland->input.code;
-    uint32_t     state   = wayland->input.modifiers;
     xkb_keysym_t aKeysym = XKB_KEY_NoSymbol;
     xkb_keysym_t bKeysym = XKB_KEY_NoSymbol;
     size_t       reprLen = 0;
@@ -363,45 +437,41 @@ setKeyRepr(
         &bKeysym,
         xkb->masks[MASK_SHIFT] | xkb->masks[MASK_CTRL]);
 
-    if (xkbIsModifierKey(aKeysym) || xkbIsModifierKey(bKeysym)) return 0;
-    if (shiftIsSignificant(aBuffer, aLen, bBuffer, bLen))
-    {
-        reprLen    = aLen;
-        *outKeysym = aKeysym;
-        state &= ~(XKB_MOD_SHIFT);
-    }
-    else
-    {
-        reprLen    = bLen;
-        *outKeysym = bKeysym;
-    }
+    entry->keysym     = XKB_KEY_NoSymbol;
+    entry->special    = SPECIAL_KEY_NONE;
+    entry->reprLength = 0;
+    entry->repr[0]    = '\0';
+
+    if (xkbIsModifierKey(aKeysym) || xkbIsModifierKey(bKeysym)) return;
 
-    key->special    = keysymToSpecialKey(*outKeysym);
-    size_t finalLen = 0;
+    entry->shiftConsumed = shiftIsSignificant(aBuffer, aLen, bBuffer, bLen);
+    reprLen              = entry->shiftConsumed ? aLen : bLen;
+    entry->keysym        = entry->shiftConsumed ? aKeysym : bKeysym;
+    entry->special       = keysymToSpecialKey(entry->keysym);
 
-    if (reprLen > 0 && isNormalKey(shiftIsSignificant(aBuffer, aLen, bBuffer, bLen) ? aBuffer : bBuffer, reprLen))
+    char*  repr     = entry->repr;
+    size_t reprSize = sizeof(entry->repr);
+
+    if (reprLen > 0 && isNormalKey(entry->shiftConsumed ? aBuffer : bBuffer, reprLen))
     {
-        const char* src = shiftIsSignificant(aBuffer, aLen, bBuffer, bLen) ? aBuffer : bBuffer;
-        finalLen        = reprLen;
-        if (finalLen >= reprBufSize) finalLen = reprBufSize - 1;
-        memcpy(reprBuf, src, finalLen);
-        reprBuf[finalLen] = '\0';
+        const char* src   = entry->shiftConsumed ? aBuffer : bBuffer;
+        entry->reprLength = reprLen;
+        if (entry->reprLength >= reprSize) entry->reprLength = reprSize - 1;
+        memcpy(repr, src, entry->reprLength);
+        repr[entry->reprLength] = '\0';
     }
-    else if (key->special != SPECIAL_KEY_NONE)
+    else if (entry->special != SPECIAL_KEY_NONE)
     {
-        const char* specialRepr = specialKeyRepr(key->special);
-        finalLen                = strlen(specialRepr);
-        if (finalLen >= reprBufSize) finalLen = reprBufSize - 1;
-        memcpy(reprBuf, specialRepr, finalLen);
-        reprBuf[finalLen] = '\0';
+        const char* specialRepr = specialKeyRepr(entry->special);
+        entry->reprLength       = strlen(specialRepr);
+        if (entry->reprLength >= reprSize) entry->reprLength = reprSize - 1;
+        memcpy(repr, specialRepr, entry->reprLength);
+        repr[entry->reprLength] = '\0';
     }
     else
     {
-        finalLen = handleMysteryKeypress(menu, *outKeysym, reprBuf, reprBufSize);
+        entry->reprLength = handleMysteryKeypress(menu, entry->keysym, repr, reprSize);
     }
-
-    setKeyMods(key, state);
-    return finalLen;
 }
 
 static Key
@@ -414,11 +484,41 @@ makeKeyFromEvent(
     size_t*       outReprLen)
 {
     assert(wayland), assert(menu), assert(keysym), assert(reprBuf), assert(outReprLen);
+    assert(reprBufSize > 0);
 
     Key key = { 0 };
     keyInit(&key);
-    *outReprLen = setKeyRepr(wayland, menu, &key, keysym, reprBuf, reprBufSize);
-    key.repr    = (String){ .data = reprBuf, .length = *outReprLen };
+
+    /* The translation only depends on the keycode and the effective
+     * modifiers and layout, which is what the table is keyed on. */
+    Input*   input   = &wayland->input;
+    uint32_t keycode = input->code;
+    uint32_t mods    = xkb_state_serialize_mods(input->xkb.state, XKB_STATE_MODS_EFFECTIVE);
+    uint32_t layout  = xkb_state_serialize_layout(input->xkb.state, XKB_STATE_LAYOUT_EFFECTIVE);
+
+    const KeyTableEntry* entry = keyTableLookup(&input->keyTable, keycode, mods, layout);
+    KeyTableEntry        translated;
+    if (!entry)
+    {
+        translated = (KeyTableEntry){ .keycode = keycode, .state = mods, .group = layout };
+        translateKey(wayland, menu, &translated);
+        keyTableInsert(&input->keyTable, &translated);
+        entry = &translated;
+    }
+
+    size_t len = entry->reprLength;
+    if (len >= reprBufSize) len = reprBufSize - 1;
+    memcpy(reprBuf, entry->repr, len);
+    reprBuf[len] = '\0';
+
+    *keysym     = entry->keysym;
+    *outReprLen = len;
+    key.special = entry->special;
+    key.repr    = (String){ .data = reprBuf, .length = len };
+    if (len > 0)
+    {
+        setKeyMods(&key, entry->shiftConsumed ? input->modifiers & ~(XKB_MOD_SHIFT) : input->modifiers);
+    }
 
     return key;
 }
@@ -677,8 +777,11 @@ recreateWindows(Menu* menu, Wayland* wayland)
     destroyWindows(wayland);
     WaylandWindow* window = calloc(1, sizeof(WaylandWindow));
     wl_list_init(&window->surfaceOutputs);
-    window->wayland  = wayland;
-    window->position = menu->position;
+    wl_list_init(&window->feedbacks);
+    window->wayland           = wayland;
+    window->position          = menu->position;
+    window->presentation      = wayland->presentation;
+    window->presentationClock = wayland->presentationClock;
 
     /* TODO this should not be necessary, but Sway 1.8.1 does not trigger event
      * surface.enter before we actually need to render the first frame.
@@ -762,53 +865,129 @@ moveToFocusedOutput(Wayland* wayland, Menu* menu)
     return wayland->input.keyboardState == KEYBOARD_HELD;
 }
 
-static MenuStatus
-pollKey(Wayland* wayland, Menu* menu)
+static bool
+regrabKeyboard(Wayland* wayland, Menu* menu)
 {
     assert(wayland), assert(menu);
 
-    if (wayland->input.keysym == XKB_KEY_NoSymbol || !wayland->input.keyPending)
+    grabKeyboard(wayland, true);
+
+    if (wayland->input.keyboardState == KEYBOARD_HELD) return true;
+
+    if (!moveToFocusedOutput(wayland, menu))
     {
-        wayland->input.keyPending = false;
-        return MENU_STATUS_RUNNING;
+        errorMsg("Could not regain keyboard focus");
+        return false;
     }
 
-    wayland->input.keyPending = false;
+    return true;
+}
 
-    xkb_keysym_t keysym;
-    char         reprBuf[128] = { 0 };
-    size_t       reprLen      = 0;
+static void
+swapState(uint32_t* a, uint32_t* b)
+{
+    assert(a), assert(b);
 
-    Key key = makeKeyFromEvent(wayland, menu, &keysym, reprBuf, sizeof(reprBuf), &reprLen);
-    if (stringIsEmpty(&key.repr))
-    {
-        return MENU_STATUS_RUNNING;
-    }
+    uint32_t tmp = *a;
+    *a           = *b;
+    *b           = tmp;
+}
+
+/* Exchange the modifier state a queued key was pressed under with the live
+ * one and rebuild the xkb state from it. translateKey rebuilds the state
+ * from these fields too, so they have to hold the key's state while it is
+ * translated. A second call puts the live state back. */
+static void
+swapPendingState(Input* input, PendingKey* pending)
+{
+    assert(input), assert(pending);
+
+    Xkb* xkb = &input->xkb;
+    swapState(&input->modifiers, &pending->modifiers);
+    swapState(&xkb->depressedMods, &pending->depressedMods);
+    swapState(&xkb->latchedMods, &pending->latchedMods);
+    swapState(&xkb->lockedMods, &pending->lockedMods);
+    swapState(&xkb->group, &pending->group);
+    xkbStateRestoreMask(xkb);
+}
+
+/* Translate a queued key under the modifiers it was pressed with. */
+static Key
+makePendingKey(
+    Wayland*      wayland,
+    Menu*         menu,
+    PendingKey*   pending,
+    xkb_keysym_t* keysym,
+    char*         reprBuf,
+    size_t        reprBufSize,
+    size_t*       outReprLen)
+{
+    assert(wayland), assert(menu), assert(pending);
+
+    Input* input  = &wayland->input;
+    input->keysym = pending->keysym;
+    input->code   = pending->code;
 
-    wayland->input.keyboardState = KEYBOARD_RELEASED;
-    grabKeyboard(wayland, false);
+    swapPendingState(input, pending);
+    Key key = makeKeyFromEvent(wayland, menu, keysym, reprBuf, reprBufSize, outReprLen);
+    swapPendingState(input, pending);
+
+    return key;
+}
+
+static MenuStatus
+pollKeys(Wayland* wayland, Menu* menu)
+{
+    assert(wayland), assert(menu);
 
-    MenuStatus status = menuHandleKeypress(menu, &key);
+    Input*     input  = &wayland->input;
+    MenuStatus status = MENU_STATUS_RUNNING;
+    size_t     count  = input->pendingKeyCount;
 
-    keyFree(&key);
+    if (!count) return MENU_STATUS_RUNNING;
 
-    if (menuStatusIsRunning(status))
+    size_t handled = 0;
+    bool   damaged = false;
+    for (size_t i = 0; i < count && menuStatusIsRunning(status); i++)
     {
-        grabKeyboard(wayland, true);
+        PendingKey* pending = &input->pendingKeys[i];
 
-        if (wayland->input.keyboardState == KEYBOARD_HELD)
-        {
-            return status;
-        }
+        xkb_keysym_t keysym;
+        char         reprBuf[128] = { 0 };
+        size_t       reprLen      = 0;
 
-        if (!moveToFocusedOutput(wayland, menu))
+        Key key = makePendingKey(wayland, menu, pending, &keysym, reprBuf, sizeof(reprBuf), &reprLen);
+        if (stringIsEmpty(&key.repr)) continue;
+
+        /* Release the keyboard once for the whole batch. */
+        if (!handled++)
         {
-            errorMsg("Could not regain keyboard focus");
-            return MENU_STATUS_EXIT_SOFTWARE;
+            input->keyboardState = KEYBOARD_RELEASED;
+            grabKeyboard(wayland, false);
         }
+
+        traceInstant(&menu->trace, TRACE_KEY, pending->code);
+        latencyKey(&menu->latency, pending->time);
+        status = menuHandleKeypress(menu, &key);
+        latencyHandled(&menu->latency, status == MENU_STATUS_DAMAGED);
+        if (status == MENU_STATUS_DAMAGED) damaged = true;
+
+        keyFree(&key);
     }
 
-    return status;
+    input->pendingKeyCount = 0;
+
+    if (!handled) return MENU_STATUS_RUNNING;
+    if (handled > 1) debugMsg(debug, "Handled %zu queued keys before drawing.", handled);
+
+    /* After a +keep command the keyboard is taken back once its deadline
+     * passes, see waylandRun. */
+    if (menuStatusIsRunning(status) && !menu->keepPending && !regrabKeyboard(wayland, menu))
+    {
+        return MENU_STATUS_EXIT_SOFTWARE;
+    }
+
+    return menuStatusIsRunning(status) && damaged ? MENU_STATUS_DAMAGED : status;
 }
 
 void
@@ -822,8 +1001,11 @@ waylandFree(Wayland* wayland)
 
     if (wayland->display)
     {
+        if (wayland->fds.command >= 0) epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.command, NULL);
+        epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.delay, NULL);
         epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.repeat, NULL);
         epoll_ctl(efd, EPOLL_CTL_DEL, wayland->fds.display, NULL);
+        close(wayland->fds.delay);
         close(wayland->fds.repeat);
         wl_display_flush(wayland->display);
         wl_display_disconnect(wayland->display);
@@ -837,15 +1019,20 @@ waylandInit(Menu* menu, Wayland* wayland)
 
     wl_list_init(&wayland->windows);
     wl_list_init(&wayland->outputs);
+    wayland->fds.command = -1;
 
     if (!(wayland->display = wl_display_connect(NULL))) goto fail;
     if (!(wayland->input.xkb.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS))) goto fail;
     if (!waylandRegistryRegister(wayland, menu)) goto fail;
 
-    wayland->fds.display      = wl_display_get_fd(wayland->display);
-    wayland->fds.repeat       = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-    wayland->input.repeatFd   = &wayland->fds.repeat;
-    wayland->input.keyPending = false;
+    wayland->fds.display           = wl_display_get_fd(wayland->display);
+    wayland->fds.repeat            = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    wayland->fds.delay             = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    wayland->input.repeatFd        = &wayland->fds.repeat;
+    wayland->input.pendingKeyCount = 0;
+    keyTableInit(&wayland->input.keyTable);
+
+    if (wayland->fds.delay < 0) goto fail;
 
     recreateWindows(menu, wayland);
 
@@ -860,6 +1047,11 @@ waylandInit(Menu* menu, Wayland* wayland)
     ep2.events   = EPOLLIN;
     ep2.data.ptr = &wayland->fds.repeat;
     epoll_ctl(efd, EPOLL_CTL_ADD, wayland->fds.repeat, &ep2);
+
+    struct epoll_event ep3;
+    ep3.events   = EPOLLIN;
+    ep3.data.ptr = &wayland->fds.delay;
+    epoll_ctl(efd, EPOLL_CTL_ADD, wayland->fds.delay, &ep3);
     return true;
 
 fail:
@@ -885,16 +1077,29 @@ waylandRun(Menu* menu)
     MenuStatus status = MENU_STATUS_EXIT_SOFTWARE;
     do
     {
+        traceCheckDump(&menu->trace);
+
         /* Exit on pointer, touch, and keyboard leave events */
         if (pollPointer(&wayland)) break;
         if (pollTouch(&wayland)) break;
         if (pollKeyboardLeft(&wayland)) break;
 
-        render(menu, &wayland);
-        switch (status = pollKey(&wayland, menu))
+        /* The +keep deadline passed, take the keyboard back. */
+        if (menuKeepExpired(menu) && !regrabKeyboard(&wayland, menu)) break;
+
+        if (!dispatch(menu, &wayland))
         {
-        case MENU_STATUS_RUNNING: break;
-        case MENU_STATUS_DAMAGED: render(menu, &wayland); break;
+            errorMsg("Could not wait for Wayland events.");
+            break;
+        }
+
+        switch (status = pollKeys(&wayland, menu))
+        {
+        case MENU_STATUS_RUNNING:
+            renderWindowsIfPending(menu, &wayland);
+            prefetchWindows(menu, &wayland);
+            break;
+        case MENU_STATUS_DAMAGED: scheduleWindowsRenderIfDirty(menu, &wayland); break;
         case MENU_STATUS_EXIT_OK: result = EX_OK; break;
         case MENU_STATUS_EXIT_SOFTWARE: result = EX_SOFTWARE; break;
         }
@@ -1,6 +1,8 @@
 #ifndef WK_WAYLAND_WAYLAND_H_
 #define WK_WAYLAND_WAYLAND_H_
 
+#include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <wayland-client.h>
 #include <xkbcommon/xkbcommon.h>
@@ -8,6 +10,9 @@
 /* common includes */
 #include "common/menu.h"
 
+/* runtime includes */
+#include "runtime/key_table.h"
+
 /* local includes */
 #include "registry.h"
 
@@ -43,6 +48,22 @@ enum
     KEYBOARD_RELEASED, /* Intentionally released for command execution */
 };
 
+#define KEY_QUEUE_SIZE 32
+
+/* A key press waiting for the event loop, with the modifier state it was
+ * pressed under. */
+typedef struct
+{
+    xkb_keysym_t keysym;
+    uint32_t     code;
+    uint32_t     modifiers;
+    uint32_t     depressedMods;
+    uint32_t     latchedMods;
+    uint32_t     lockedMods;
+    uint32_t     group;
+    uint32_t     time;
+} PendingKey;
+
 typedef struct
 {
     struct xkb_state*   state;
@@ -53,6 +74,16 @@ typedef struct
     uint32_t            latchedMods;
     uint32_t            lockedMods;
     uint32_t            group;
+    uint64_t            keymapHash;
+    struct
+    {
+        pthread_t          thread;
+        bool               running;
+        char*              map;
+        uint32_t           size;
+        uint64_t           hash;
+        struct xkb_keymap* keymap;
+    } compile;
 } Xkb;
 
 typedef struct
@@ -106,6 +137,7 @@ typedef struct
     PointerEvent        pointerEvent;
     TouchEvent          touchEvent;
     Xkb                 xkb;
+    KeyTable            keyTable;
 
     xkb_keysym_t keysym;
     uint32_t     code;
@@ -131,7 +163,8 @@ typedef struct
         void (*key)(enum wl_keyboard_key_state state, xkb_keysym_t keysym, uint32_t code);
     } notify;
 
-    bool          keyPending;
+    PendingKey    pendingKeys[KEY_QUEUE_SIZE];
+    size_t        pendingKeyCount;
     KeyboardState keyboardState;
 } Input;
 
@@ -158,6 +191,8 @@ typedef struct Wayland
     {
         int32_t display;
         int32_t repeat;
+        int32_t delay;
+        int32_t command;
     } fds;
 
     struct wl_display*                     display;
@@ -169,9 +204,12 @@ typedef struct Wayland
     struct zwlr_layer_shell_v1*            layerShell;
     struct wl_shm*                         shm;
     struct wp_fractional_scale_manager_v1* fractionalScaleManager;
+    struct wp_presentation*                presentation;
+    uint32_t                               presentationClock;
     Input                                  input;
     struct wl_list                         windows;
     uint32_t                               formats;
+    bool                                   delayed;
 } Wayland;
 
 void waylandFree(Wayland* wayland);
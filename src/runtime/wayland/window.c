@@ -8,14 +8,17 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sysexits.h>
+#include <time.h>
 #include <unistd.h>
 #include <wayland-client-core.h>
 #include <wayland-client-protocol.h>
 
 /* common includes */
 #include "common/common.h"
+#include "common/debug.h"
 #include "common/memory.h"
 #include "common/menu.h"
+#include "common/trace.h"
 
 /* runtime includes */
 #include "runtime/cairo.h"
@@ -23,6 +26,7 @@
 /* local includes */
 #include "debug.h"
 #include "fractional-scale-v1.h"
+#include "presentation-time.h"
 #include "window.h"
 #include "wlr-layer-shell-unstable-v1.h"
 
@@ -125,25 +129,31 @@ destroyBuffer(Buffer* buffer)
     memset(buffer, 0, sizeof(Buffer));
 }
 
+static void
+destroyPool(ShmPool* pool)
+{
+    assert(pool);
+
+    if (!pool->pool) return;
+
+    wl_shm_pool_destroy(pool->pool);
+    munmap(pool->data, pool->size);
+    close(pool->fd);
+    memset(pool, 0, sizeof(ShmPool));
+}
+
 static bool
-createBuffer(
-    struct wl_shm* shm,
-    Buffer*        buffer,
-    int32_t        width,
-    int32_t        height,
-    uint32_t       format,
-    double         scale,
-    CairoPaint*    paint)
+createPool(WaylandWindow* window, size_t slotSize)
 {
-    assert(shm), assert(buffer), assert(paint);
+    assert(window);
 
-    uint32_t stride = width * 4;
-    uint32_t size   = stride * height;
-    int      fd     = osCreateAnonymousFile(size);
+    ShmPool* pool = &window->pool;
+    size_t   size = slotSize * WINDOW_BUFFER_COUNT;
+    int      fd   = osCreateAnonymousFile(size);
 
     if (fd < 0)
     {
-        errorMsg("Wayland: Creating a buffer file for %d B failed.", size);
+        errorMsg("Wayland: Creating a buffer file for %zu B failed.", size);
         return false;
     }
 
@@ -155,27 +165,113 @@ createBuffer(
         return false;
     }
 
-    struct wl_shm_pool* pool = wl_shm_create_pool(shm, fd, size);
-    if (!pool)
+    struct wl_shm_pool* shmPool = wl_shm_create_pool(window->shm, fd, size);
+    if (!shmPool)
     {
         errorMsg("Wayland: wl_shm_create_pool failed.");
+        munmap(data, size);
         close(fd);
         return false;
     }
 
-    buffer->buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride, format);
-    if (!buffer->buffer) goto fail;
+    pool->pool     = shmPool;
+    pool->data     = data;
+    pool->fd       = fd;
+    pool->size     = size;
+    pool->base     = 0;
+    pool->slotSize = slotSize;
+    return true;
+}
+
+/* Grow the pool so every slot holds 'slotSize' bytes. Slots that are still
+ * held by the compositor keep their memory, the new slots start after them. */
+static bool
+growPool(WaylandWindow* window, size_t slotSize)
+{
+    assert(window);
 
-    wl_shm_pool_destroy(pool);
-    pool = NULL;
+    ShmPool* pool = &window->pool;
+    bool     busy = false;
 
-    close(fd);
-    fd = -1;
+    for (size_t i = 0; i < WINDOW_BUFFER_COUNT; i++)
+    {
+        if (window->buffers[i].busy) busy = true;
+        destroyBuffer(&window->buffers[i]);
+    }
+
+    size_t base = busy ? pool->size : 0;
+    size_t size = base + slotSize * WINDOW_BUFFER_COUNT;
+    if (size < pool->size) size = pool->size;
+
+    if (ftruncate(pool->fd, size) < 0)
+    {
+        errorMsg("Wayland: Growing the buffer file to %zu B failed.", size);
+        return false;
+    }
+
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        errorMsg("Wayland: mmap failed.");
+        return false;
+    }
+
+    munmap(pool->data, pool->size);
+    wl_shm_pool_resize(pool->pool, size);
+    pool->data     = data;
+    pool->size     = size;
+    pool->base     = base;
+    pool->slotSize = slotSize;
+    return true;
+}
+
+/* Make sure a slot can hold 'needed' bytes. The pool is sized for a buffer
+ * covering the whole output, so menu size changes never touch it. */
+static bool
+reservePool(WaylandWindow* window, size_t needed)
+{
+    assert(window);
+
+    ShmPool* pool = &window->pool;
+    if (pool->pool && needed <= pool->slotSize) return true;
+
+    size_t intScale = window->integerScale > 0 ? window->integerScale : 1;
+    size_t maxSize  = (size_t)window->maxWidth * intScale * 4 * window->maxHeight * intScale;
+    size_t slotSize = needed > maxSize ? needed : maxSize;
+
+    if (!pool->pool) return createPool(window, slotSize);
+    return growPool(window, slotSize);
+}
+
+static bool
+createBuffer(
+    WaylandWindow* window,
+    Buffer*        buffer,
+    size_t         slot,
+    int32_t        width,
+    int32_t        height,
+    uint32_t       format,
+    double         scale)
+{
+    assert(window), assert(buffer), assert(slot < WINDOW_BUFFER_COUNT);
+
+    ShmPool* pool   = &window->pool;
+    uint32_t stride = width * 4;
+    size_t   offset = pool->base + slot * pool->slotSize;
+
+    assert((size_t)stride * height <= pool->slotSize);
+
+    buffer->buffer = wl_shm_pool_create_buffer(pool->pool, offset, width, height, stride, format);
+    if (!buffer->buffer) goto fail;
 
     wl_buffer_add_listener(buffer->buffer, &bufferListener, buffer);
 
-    cairo_surface_t* surface =
-        cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, width, height, stride);
+    cairo_surface_t* surface = cairo_image_surface_create_for_data(
+        (unsigned char*)pool->data + offset,
+        CAIRO_FORMAT_ARGB32,
+        width,
+        height,
+        stride);
     if (!surface) goto fail;
 
     buffer->cairo.scale = scale;
@@ -186,51 +282,55 @@ createBuffer(
         goto fail;
     }
 
-    buffer->cairo.paint = paint;
-    buffer->width       = width;
-    buffer->height      = height;
+    buffer->cairo.paint       = &window->paint;
+    buffer->cairo.cellCache   = &window->cellCache;
+    buffer->cairo.chromeCache = &window->chromeCache;
+    buffer->cairo.tiles       = &window->tiles;
+    buffer->cairo.presented   = &window->presented;
+    buffer->width             = width;
+    buffer->height            = height;
     return true;
 
 fail:
-    if (fd > -1) close(fd);
-    if (pool) wl_shm_pool_destroy(pool);
     destroyBuffer(buffer);
     return false;
 }
 
+/* The third buffer is only created when the compositor holds on to both of
+ * the others. */
 static Buffer*
 nextBuffer(WaylandWindow* window)
 {
     assert(window);
 
-    Buffer* buffer = NULL;
-    for (size_t i = 0; i < 2; i++)
+    size_t slot = 0;
+    for (; slot < WINDOW_BUFFER_COUNT; slot++)
     {
-        if (window->buffers[i].busy) continue;
-
-        buffer = &window->buffers[i];
-        break;
+        if (!window->buffers[slot].busy) break;
     }
 
-    if (!buffer) return NULL;
+    if (slot == WINDOW_BUFFER_COUNT) return NULL;
 
+    Buffer* buffer     = &window->buffers[slot];
     int32_t intScale   = window->integerScale > 0 ? window->integerScale : 1;
     int32_t physWidth  = window->width * intScale;
     int32_t physHeight = window->height * intScale;
 
+    if (!reservePool(window, (size_t)physWidth * 4 * physHeight)) return NULL;
+
     if (physWidth != (int32_t)buffer->width || physHeight != (int32_t)buffer->height)
     {
         destroyBuffer(buffer);
     }
 
     if (!buffer->buffer && !createBuffer(
-                               window->shm,
+                               window,
                                buffer,
+                               slot,
                                physWidth,
                                physHeight,
                                WL_SHM_FORMAT_ARGB8888,
-                               (double)intScale,
-                               &window->paint))
+                               (double)intScale))
     {
         return NULL;
     }
@@ -252,6 +352,88 @@ static const struct wl_callback_listener callbackListener = {
     frameCallback,
 };
 
+static void
+destroyFeedback(PresentationFeedback* feedback)
+{
+    assert(feedback);
+
+    wp_presentation_feedback_destroy(feedback->feedback);
+    wl_list_remove(&feedback->link);
+    free(feedback);
+}
+
+static void
+feedbackSyncOutput(void* data, struct wp_presentation_feedback* feedback, struct wl_output* output)
+{
+    (void)data, (void)feedback, (void)output;
+}
+
+static void
+feedbackPresented(
+    void*                            data,
+    struct wp_presentation_feedback* wpFeedback,
+    uint32_t                         secHi,
+    uint32_t                         secLo,
+    uint32_t                         nsec,
+    uint32_t                         refresh,
+    uint32_t                         seqHi,
+    uint32_t                         seqLo,
+    uint32_t                         flags)
+{
+    (void)wpFeedback, (void)refresh, (void)seqHi, (void)seqLo, (void)flags;
+    PresentationFeedback* feedback = data;
+
+    /* Keys are timed on CLOCK_MONOTONIC. On any other clock the time the
+     * report arrived is the closest there is. */
+    struct timespec when;
+    if (feedback->clock == CLOCK_MONOTONIC)
+    {
+        when.tv_sec  = (time_t)(((uint64_t)secHi << 32) | secLo);
+        when.tv_nsec = nsec;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &when);
+    }
+
+    latencyPresented(feedback->latency, &feedback->frame, &when);
+    destroyFeedback(feedback);
+}
+
+static void
+feedbackDiscarded(void* data, struct wp_presentation_feedback* feedback)
+{
+    (void)feedback;
+    destroyFeedback(data);
+}
+
+static const struct wp_presentation_feedback_listener feedbackListener = {
+    .sync_output = feedbackSyncOutput,
+    .presented   = feedbackPresented,
+    .discarded   = feedbackDiscarded,
+};
+
+/* Ask when the next commit reaches the screen, if it shows keys that are
+ * being timed. */
+static PresentationFeedback*
+requestFeedback(WaylandWindow* window, Menu* menu)
+{
+    assert(window), assert(menu);
+
+    if (!window->presentation || !menu->latency.enabled || !menu->latency.frame.count) return NULL;
+
+    PresentationFeedback* feedback = calloc(1, sizeof(PresentationFeedback));
+    if (!feedback) return NULL;
+
+    feedback->feedback = wp_presentation_feedback(window->presentation, window->surface);
+    feedback->latency  = &menu->latency;
+    feedback->clock    = window->presentationClock;
+    wp_presentation_feedback_add_listener(feedback->feedback, &feedbackListener, feedback);
+    wl_list_insert(&window->feedbacks, &feedback->link);
+
+    return feedback;
+}
+
 static uint32_t
 getAlignAnchor(MenuPosition position)
 {
@@ -269,6 +451,27 @@ getAlignAnchor(MenuPosition position)
     return anchor;
 }
 
+/* Draw the most used prefixes of the current level into this window's
+ * caches, once per level. Any buffer that was drawn before will do as the
+ * target, nothing is drawn into it. */
+void
+windowPrefetch(WaylandWindow* window, Menu* menu)
+{
+    assert(window), assert(menu);
+
+    if (window->prefetched == menu->keyChords) return;
+
+    for (size_t i = 0; i < WINDOW_BUFFER_COUNT; i++)
+    {
+        Buffer* buffer = &window->buffers[i];
+        if (!buffer->buffer) continue;
+
+        window->prefetched = menu->keyChords;
+        cairoPrefetch(&buffer->cairo, menu, window->width, window->maxHeight);
+        return;
+    }
+}
+
 void
 windowScheduleRender(WaylandWindow* window)
 {
@@ -370,18 +573,17 @@ resizeWindow(WaylandWindow* window, Menu* menu)
     resizeWinGap(window, menu);
 }
 
+/* Send the size, anchor, and margins the menu wants. Nothing waits here, the
+ * state takes effect with the next surface commit. */
 static void
-moveResizeWindow(WaylandWindow* window, Buffer* buffer, struct wl_display* display)
+configureSurface(WaylandWindow* window)
 {
-    assert(window), assert(buffer);
+    assert(window);
 
-    /* Layer shell expects logical (surface-local) coordinates.
-     * Buffer dimensions are physical (logical * scale), so divide by scale.
-     * window->maxWidth and window->windowGap are already logical (set in
-     * windowUpdateOutput), so use them directly. */
-    double  scale         = buffer->cairo.scale > 0 ? buffer->cairo.scale : 1.0;
-    int32_t logicalWidth  = (int32_t)(buffer->width / scale);
-    int32_t logicalHeight = (int32_t)(buffer->height / scale);
+    /* Layer shell expects logical (surface-local) coordinates. window->width,
+     * window->height, window->maxWidth and window->windowGap are all logical. */
+    int32_t logicalWidth  = (int32_t)window->width;
+    int32_t logicalHeight = (int32_t)window->height;
     int32_t leftMargin    = ((int32_t)window->maxWidth - logicalWidth) / 2;
 
     zwlr_layer_surface_v1_set_size(window->layerSurface, logicalWidth, logicalHeight);
@@ -413,8 +615,33 @@ moveResizeWindow(WaylandWindow* window, Buffer* buffer, struct wl_display* displ
             0,
             leftMargin);
     }
-    wl_surface_commit(window->surface);
-    wl_display_roundtrip(display);
+
+    window->requestedWidth  = window->width;
+    window->requestedHeight = window->height;
+    window->requestedGap    = window->windowGap;
+}
+
+/* Damage is tracked in surface-local units, the buffer is scaled. */
+static void
+damageBuffer(WaylandWindow* window, Buffer* buffer, int32_t scale)
+{
+    assert(window), assert(buffer);
+
+    cairo_region_t* damage = buffer->cairo.damage;
+    if (!damage) return;
+
+    int count = cairo_region_num_rectangles(damage);
+    for (int i = 0; i < count; i++)
+    {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(damage, i, &rect);
+        wl_surface_damage_buffer(
+            window->surface,
+            rect.x * scale,
+            rect.y * scale,
+            rect.width * scale,
+            rect.height * scale);
+    }
 }
 
 bool
@@ -424,7 +651,26 @@ windowRender(WaylandWindow* window, struct wl_display* display, Menu* menu)
 
     resizeWindow(window, menu);
 
-    if (menu->debug) disassembleWaylandWindow(window);
+    if (menu->debug && !traceIsRunning(&menu->trace)) disassembleWaylandWindow(window);
+
+    bool resized = window->width != window->requestedWidth ||
+                   window->height != window->requestedHeight;
+    if (resized || window->windowGap != window->requestedGap) configureSurface(window);
+
+    /* A new size is committed on its own and drawn once the compositor
+     * acknowledges it with a configure event, see layerSurfaceConfigure. */
+    if (resized)
+    {
+        debugMsg(menu->debug, "Waiting for configure: %ux%u.", window->width, window->height);
+        window->configured = false;
+        wl_surface_commit(window->surface);
+    }
+
+    if (!window->configured)
+    {
+        window->renderPending = false;
+        return true;
+    }
 
     Buffer* buffer = nextBuffer(window);
     if (!buffer)
@@ -433,23 +679,34 @@ windowRender(WaylandWindow* window, struct wl_display* display, Menu* menu)
         return false;
     }
 
+    traceBegin(&menu->trace, TRACE_RENDER);
+
     menu->width  = buffer->width;
     menu->height = buffer->height;
+    if (!menuIsDelayed(menu)) cairoSpeculationFinish(&window->speculation, &buffer->cairo);
+    traceBegin(&menu->trace, TRACE_PAINT);
     window->render(&buffer->cairo, menu);
     cairo_surface_flush(buffer->cairo.surface);
-
-    moveResizeWindow(window, buffer, display);
+    traceEnd(&menu->trace, TRACE_PAINT, 0);
+    latencyPainted(&menu->latency);
 
     int32_t bufferScale = window->integerScale > 0 ? window->integerScale : 1;
     wl_surface_set_buffer_scale(window->surface, bufferScale);
-    wl_surface_damage_buffer(window->surface, 0, 0, buffer->width, buffer->height);
+    damageBuffer(window, buffer, bufferScale);
     wl_surface_attach(window->surface, buffer->buffer, 0, 0);
+
+    PresentationFeedback* feedback = requestFeedback(window, menu);
     wl_surface_commit(window->surface);
+    latencyCommit(&menu->latency, feedback ? &feedback->frame : NULL);
+    traceEnd(&menu->trace, TRACE_RENDER, buffer->height);
     buffer->busy = true;
 
-    /* Always clear renderPending after render, re-schedule if still delayed */
+    /* Nothing is drawn again until the delay runs out, see dispatch. */
     window->renderPending = false;
-    if (menuIsDelayed(menu)) windowScheduleRender(window);
+    if (menuIsDelayed(menu))
+    {
+        cairoSpeculationStart(&window->speculation, &buffer->cairo, menu, window->width, window->maxHeight);
+    }
 
     return true;
 }
@@ -459,10 +716,24 @@ windowDestroy(WaylandWindow* window)
 {
     assert(window);
 
-    for (size_t i = 0; i < 2; i++)
+    for (size_t i = 0; i < WINDOW_BUFFER_COUNT; i++)
     {
         destroyBuffer(&window->buffers[i]);
     }
+    destroyPool(&window->pool);
+
+    cairoSpeculationFinish(&window->speculation, NULL);
+    cacheFree(&window->cellCache);
+    cacheFree(&window->chromeCache);
+    cairoTilesFree(&window->tiles);
+    cairoFrameFree(&window->presented);
+
+    PresentationFeedback* feedback;
+    PresentationFeedback* next;
+    wl_list_for_each_safe(feedback, next, &window->feedbacks, link)
+    {
+        destroyFeedback(feedback);
+    }
 
     if (window->fractionalScale) wp_fractional_scale_v1_destroy(window->fractionalScale);
     if (window->layerSurface) zwlr_layer_surface_v1_destroy(window->layerSurface);
@@ -480,6 +751,8 @@ layerSurfaceConfigure(
     WaylandWindow* window = data;
     window->width         = width;
     window->height        = height;
+    window->configured    = true;
+    window->renderPending = true;
     zwlr_layer_surface_v1_ack_configure(layerSurface, serial);
 }
 
@@ -497,22 +770,6 @@ static const struct zwlr_layer_surface_v1_listener layerSurfaceListener = {
     .closed    = layerSurfaceClosed,
 };
 
-static uint32_t
-getWindowWidth(WaylandWindow* window)
-{
-    assert(window);
-
-    return window->width;
-}
-
-static uint32_t
-getWindowHeight(WaylandWindow* window, Menu* menu)
-{
-    assert(window), assert(menu);
-
-    return cairoHeight(menu, getThrowawaySurface(window), window->maxHeight);
-}
-
 void
 windowGrabKeyboard(WaylandWindow* window, struct wl_display* display, bool grab)
 {
@@ -520,7 +777,7 @@ windowGrabKeyboard(WaylandWindow* window, struct wl_display* display, bool grab)
 
     zwlr_layer_surface_v1_set_keyboard_interactivity(window->layerSurface, grab);
     wl_surface_commit(window->surface);
-    wl_display_roundtrip(display);
+    wl_display_flush(display);
 }
 
 void
@@ -532,7 +789,7 @@ windowSetOverlap(WaylandWindow* window, struct wl_display* display, bool overlap
         window->layerSurface,
         overlap ? -1 : 0); /* or ... -overlap */
     wl_surface_commit(window->surface);
-    wl_display_roundtrip(display);
+    wl_display_flush(display);
 }
 
 bool
@@ -560,18 +817,21 @@ windowCreate(
     zwlr_layer_surface_v1_set_anchor(window->layerSurface, window->alignAnchor);
     zwlr_layer_surface_v1_set_size(window->layerSurface, 0, 32);
 
+    /* The initial commit has no buffer. The compositor answers it with a
+     * configure event, and the first frame is drawn after that. */
+    window->shm        = shm;
+    window->surface    = surface;
+    window->configured = false;
     wl_surface_commit(surface);
-    wl_display_roundtrip(display);
-
-    zwlr_layer_surface_v1_set_size(
-        window->layerSurface,
-        getWindowWidth(window),
-        getWindowHeight(window, menu));
-
-    window->shm     = shm;
-    window->surface = surface;
+    wl_display_flush(display);
 
     cairoPaintInit(menu, &window->paint);
+    cacheInit(&window->cellCache, CACHE_CELL_CAPACITY, menu->cache);
+    cacheInit(&window->chromeCache, CACHE_CHROME_CAPACITY, menu->cache);
+    cairoTilesInit(&window->tiles);
+    cairoFrameInit(&window->presented);
+    window->prefetched          = NULL;
+    window->speculation.started = false;
 
     return true;
 }
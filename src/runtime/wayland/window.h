@@ -7,6 +7,7 @@
 #include <wayland-util.h>
 
 /* common includes */
+#include "common/latency.h"
 #include "common/menu.h"
 
 /* runtime includes */
@@ -15,6 +16,8 @@
 /* local includes */
 #include "wlr-layer-shell-unstable-v1.h"
 
+#define WINDOW_BUFFER_COUNT 3
+
 typedef struct
 {
     Cairo             cairo;
@@ -24,6 +27,27 @@ typedef struct
     bool              busy;
 } Buffer;
 
+/* One shared memory file per window, split into a slot per buffer */
+typedef struct
+{
+    struct wl_shm_pool* pool;
+    void*               data;
+    int                 fd;
+    size_t              size;
+    size_t              base;
+    size_t              slotSize;
+} ShmPool;
+
+/* Presentation feedback requested for a frame, with the keys it shows. */
+typedef struct
+{
+    struct wp_presentation_feedback* feedback;
+    Latency*                         latency;
+    LatencyFrame                     frame;
+    uint32_t                         clock;
+    struct wl_list                   link;
+} PresentationFeedback;
+
 typedef struct
 {
     struct Wayland*                wayland;
@@ -32,14 +56,27 @@ typedef struct
     struct wl_callback*            framecb;
     struct zwlr_layer_surface_v1*  layerSurface;
     struct wp_fractional_scale_v1* fractionalScale;
+    struct wp_presentation*        presentation;
+    uint32_t                       presentationClock;
+    struct wl_list                 feedbacks;
     struct wl_shm*                 shm;
-    Buffer                         buffers[2];
+    ShmPool                        pool;
+    Buffer                         buffers[WINDOW_BUFFER_COUNT];
     CairoPaint                     paint;
+    Cache                          cellCache;
+    Cache                          chromeCache;
+    CairoTiles                     tiles;
+    CairoFrame                     presented;
+    Span*                          prefetched;
+    CairoSpeculation               speculation;
     uint32_t                       windowGap;
     uint32_t                       width;
     uint32_t                       height;
     uint32_t                       maxWidth;
     uint32_t                       maxHeight;
+    uint32_t                       requestedWidth;
+    uint32_t                       requestedHeight;
+    uint32_t                       requestedGap;
     double                         scale;
     int32_t                        integerScale;
     uint32_t                       displayed;
@@ -47,9 +84,11 @@ typedef struct
     MenuPosition                   position;
     uint32_t                       alignAnchor;
     bool                           renderPending;
+    bool                           configured;
     bool (*render)(Cairo* cairo, Menu* menu);
 } WaylandWindow;
 
+void windowPrefetch(WaylandWindow* window, Menu* menu);
 void windowScheduleRender(WaylandWindow* window);
 bool windowRender(WaylandWindow* window, struct wl_display* display, Menu* menu);
 void windowDestroy(WaylandWindow* window);
@@ -1,11 +1,17 @@
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/timerfd.h>
 #include <sysexits.h>
 #include <time.h>
 #include <unistd.h>
@@ -14,6 +20,7 @@
 #include <X11/XF86keysym.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 #include <X11/extensions/Xinerama.h>
 #include <cairo-xlib.h>
 
@@ -21,12 +28,15 @@
 #include "common/common.h"
 #include "common/debug.h"
 #include "common/key_chord.h"
+#include "common/latency.h"
 #include "common/menu.h"
+#include "common/trace.h"
 
 /* runtime includes */
 #include "common/string.h"
 #include "runtime/cairo.h"
 #include "runtime/common.h"
+#include "runtime/key_table.h"
 
 /* local includes */
 #include "debug.h"
@@ -336,7 +346,10 @@ initX11(X11* x11, X11Window* window, Menu* menu)
     debugMsg(menu->debug, "Initializing x11.");
     Display* display = window->display = x11->dispaly = XOpenDisplay(NULL);
     if (!x11->dispaly) return false;
+    /* Commands are spawned without forking wk, keep them off the connection. */
+    fcntl(ConnectionNumber(display), F_SETFD, FD_CLOEXEC);
     window->screen = DefaultScreen(display);
+    window->delayFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
     window->width = window->height = 1;
     window->border                 = menu->borderWidth;
     window->monitor                = -1;
@@ -373,18 +386,16 @@ initX11(X11* x11, X11Window* window, Menu* menu)
         window->visual,
         valuemask,
         &wa);
-    XSelectInput(display, window->drawable, ButtonPressMask | KeyPressMask);
+    XSelectInput(display, window->drawable, ExposureMask | ButtonPressMask | KeyPressMask);
     XMapRaised(display, window->drawable);
-    window->xim = XOpenIM(display, NULL, NULL, NULL);
-    window->xic = XCreateIC(
-        window->xim,
-        XNInputStyle,
-        XIMPreeditNothing | XIMStatusNothing,
-        XNClientWindow,
-        window->drawable,
-        XNFocusWindow,
-        window->drawable,
-        NULL);
+    window->depth        = depth;
+    window->clientRender = menu->clientRender;
+    if (window->clientRender)
+    {
+        window->gc           = XCreateGC(display, window->drawable, 0, NULL);
+        window->shmAvailable = XShmQueryExtension(display);
+        debugMsg(menu->debug, "Client side rendering, MIT-SHM %s.", window->shmAvailable ? "available" : "unavailable");
+    }
     XSetClassHint(display, window->drawable, (XClassHint[]){
                                                  { .res_name = "wk", .res_class = "wk" }
     });
@@ -392,34 +403,278 @@ initX11(X11* x11, X11Window* window, Menu* menu)
     window->render = cairoPaint;
     initBuffer(window);
     cairoPaintInit(menu, &window->paint);
+    cacheInit(&window->cellCache, CACHE_CELL_CAPACITY, menu->cache);
+    cacheInit(&window->chromeCache, CACHE_CHROME_CAPACITY, menu->cache);
+    cairoTilesInit(&window->tiles);
+    keyTableInit(&window->keyTable);
+    window->prefetched = NULL;
+    window->speculation.started = false;
     if (menu->debug) disassembleX11Window(window);
     return true;
 }
 
+/* Connecting to an input method server, or loading the compose tables of the
+ * built-in one, can take longer than everything else before the first frame,
+ * so this runs once the menu is on screen. Keys that arrive in the meantime
+ * wait in the X queue. */
 static void
-destroyBuffer(Buffer* buffer)
+initInputMethod(X11Window* window, Menu* menu)
 {
-    assert(buffer);
+    assert(window), assert(menu);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
+    window->xim = XOpenIM(window->display, NULL, NULL, NULL);
+    if (!window->xim)
+    {
+        warnMsg("Could not open input method, composed input is unavailable.");
+        return;
+    }
+
+    window->xic = XCreateIC(
+        window->xim,
+        XNInputStyle,
+        XIMPreeditNothing | XIMStatusNothing,
+        XNClientWindow,
+        window->drawable,
+        XNFocusWindow,
+        window->drawable,
+        NULL);
+    if (!window->xic)
+    {
+        warnMsg("Could not create input context, composed input is unavailable.");
+        XCloseIM(window->xim);
+        window->xim = NULL;
+        return;
+    }
+
+    debugMsg(menu->debug, "Input method ready in %.2f ms.", elapsedMs(&start));
+}
+
+static void
+destroyBuffer(X11Window* window, Buffer* buffer)
+{
+    assert(window), assert(buffer);
+
+    /* The surface draws into the image data, so it goes first. */
     cairoDestroy(&buffer->cairo);
+    if (buffer->image)
+    {
+        if (buffer->shared)
+        {
+            XShmDetach(window->display, &buffer->shm);
+            shmdt(buffer->shm.shmaddr);
+            buffer->image->data = NULL;
+        }
+        XDestroyImage(buffer->image);
+    }
     memset(buffer, 0, sizeof(Buffer));
 }
 
+static bool shmFailed = false;
+
+static int
+shmErrorHandler(Display* display, XErrorEvent* event)
+{
+    (void)display, (void)event;
+    shmFailed = true;
+    return 0;
+}
+
+/* Share the image with the server. Attaching fails with BadAccess when the
+ * server can't reach our memory, e.g. over the network. */
 static bool
-createBuffer(X11Window* window, Buffer* buffer)
+attachSharedImage(X11Window* window, Buffer* buffer)
 {
     assert(window), assert(buffer);
 
-    cairo_surface_t* surface = cairo_xlib_surface_create(
+    XImage* image = XShmCreateImage(
         window->display,
-        window->drawable,
         window->visual,
+        window->depth,
+        ZPixmap,
+        NULL,
+        &buffer->shm,
         window->width,
         window->height);
+    if (!image) return false;
+    if (image->bits_per_pixel != 32) goto fail;
+
+    buffer->shm.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (buffer->shm.shmid < 0) goto fail;
+
+    buffer->shm.shmaddr = image->data = shmat(buffer->shm.shmid, NULL, 0);
+    buffer->shm.readOnly = False;
+    if (buffer->shm.shmaddr == (char*)-1)
+    {
+        shmctl(buffer->shm.shmid, IPC_RMID, NULL);
+        goto fail;
+    }
+
+    XSync(window->display, False);
+    XErrorHandler handler = XSetErrorHandler(shmErrorHandler);
+    shmFailed             = false;
+    XShmAttach(window->display, &buffer->shm);
+    XSync(window->display, False);
+    XSetErrorHandler(handler);
+
+    /* The segment goes away once both sides have detached. */
+    shmctl(buffer->shm.shmid, IPC_RMID, NULL);
+
+    if (shmFailed)
+    {
+        shmdt(buffer->shm.shmaddr);
+        goto fail;
+    }
+
+    buffer->image  = image;
+    buffer->shared = true;
+    return true;
+
+fail:
+    image->data = NULL;
+    XDestroyImage(image);
+    return false;
+}
+
+static bool
+createImage(X11Window* window, Buffer* buffer)
+{
+    assert(window), assert(buffer);
+
+    cairo_format_t format = window->depth == 32 ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+    int            stride = cairo_format_stride_for_width(format, window->width);
+    char*          data   = calloc(1, (size_t)stride * window->height);
+    if (!data) return false;
+
+    XImage* image = XCreateImage(
+        window->display,
+        window->visual,
+        window->depth,
+        ZPixmap,
+        0,
+        data,
+        window->width,
+        window->height,
+        32,
+        stride);
+    if (!image || image->bits_per_pixel != 32)
+    {
+        if (image) XDestroyImage(image);
+        else free(data);
+        return false;
+    }
+
+    /* Cairo writes pixels in host order, Xlib swaps them if the server
+     * differs. */
+    static const uint16_t one = 1;
+    image->byte_order         = *(const uint8_t*)&one ? LSBFirst : MSBFirst;
+
+    buffer->image  = image;
+    buffer->shared = false;
+    return true;
+}
+
+/* Draw on the client into an image the size of the window. Returns NULL if
+ * the visual can't be matched to a cairo format. */
+static cairo_surface_t*
+createImageSurface(X11Window* window, Buffer* buffer)
+{
+    assert(window), assert(buffer);
+
+    if (window->shmAvailable && !attachSharedImage(window, buffer))
+    {
+        warnMsg("Could not share image with the X server, falling back to XPutImage.");
+        window->shmAvailable = false;
+    }
+    if (!buffer->image && !createImage(window, buffer)) return NULL;
+
+    cairo_format_t format = window->depth == 32 ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+    return cairo_image_surface_create_for_data(
+        (unsigned char*)buffer->image->data,
+        format,
+        window->width,
+        window->height,
+        buffer->image->bytes_per_line);
+}
+
+/* Upload the areas that changed in the last frame. */
+static void
+presentBuffer(X11Window* window, Buffer* buffer)
+{
+    assert(window), assert(buffer);
+
+    cairo_region_t* damage = buffer->cairo.damage;
+    if (!buffer->image || !damage || cairo_region_is_empty(damage)) return;
+
+    cairo_rectangle_int_t full   = { 0, 0, buffer->width, buffer->height };
+    cairo_region_t*       region = cairo_region_copy(damage);
+    cairo_region_intersect_rectangle(region, &full);
+
+    int count = cairo_region_num_rectangles(region);
+    for (int i = 0; i < count; i++)
+    {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(region, i, &rect);
+        if (buffer->shared)
+        {
+            XShmPutImage(
+                window->display,
+                window->drawable,
+                window->gc,
+                buffer->image,
+                rect.x,
+                rect.y,
+                rect.x,
+                rect.y,
+                rect.width,
+                rect.height,
+                False);
+        }
+        else
+        {
+            XPutImage(
+                window->display,
+                window->drawable,
+                window->gc,
+                buffer->image,
+                rect.x,
+                rect.y,
+                rect.x,
+                rect.y,
+                rect.width,
+                rect.height);
+        }
+    }
+
+    cairo_region_destroy(region);
+
+    /* The server reads shared memory after the request is sent, so wait for
+     * it before the next frame draws into the same image. */
+    if (buffer->shared) XSync(window->display, False);
+}
+
+static bool
+createBuffer(X11Window* window, Buffer* buffer)
+{
+    assert(window), assert(buffer);
+
+    cairo_surface_t* surface = NULL;
+    if (window->clientRender) surface = createImageSurface(window, buffer);
+    if (!surface)
+    {
+        surface = cairo_xlib_surface_create(
+            window->display,
+            window->drawable,
+            window->visual,
+            window->width,
+            window->height);
+        if (surface) cairo_xlib_surface_set_size(surface, window->width, window->height);
+    }
 
     if (!surface) goto fail;
 
-    cairo_xlib_surface_set_size(surface, window->width, window->height);
     buffer->cairo.scale = 1;
 
     if (!cairoCreateForSurface(&buffer->cairo, surface))
@@ -428,14 +683,17 @@ createBuffer(X11Window* window, Buffer* buffer)
         goto fail;
     }
 
-    buffer->cairo.paint = &window->paint;
-    buffer->width       = window->width;
-    buffer->height      = window->height;
-    buffer->created     = true;
+    buffer->cairo.paint       = &window->paint;
+    buffer->cairo.cellCache   = &window->cellCache;
+    buffer->cairo.chromeCache = &window->chromeCache;
+    buffer->cairo.tiles       = &window->tiles;
+    buffer->width             = window->width;
+    buffer->height            = window->height;
+    buffer->created           = true;
     return true;
 
 fail:
-    destroyBuffer(buffer);
+    destroyBuffer(window, buffer);
     return false;
 }
 
@@ -447,7 +705,7 @@ getBuffer(X11Window* window)
     Buffer* buffer = &window->buffer;
 
     if (!buffer) return NULL;
-    if (window->height != buffer->height) destroyBuffer(buffer);
+    if (window->height != buffer->height) destroyBuffer(window, buffer);
     if (!buffer->created && !createBuffer(window, buffer)) return NULL;
 
     return buffer;
@@ -480,11 +738,28 @@ render(X11Window* window, Menu* menu)
         return false;
     }
 
+    traceBegin(&menu->trace, TRACE_RENDER);
+
     menu->width  = buffer->width;
     menu->height = buffer->height;
+    if (!menuIsDelayed(menu)) cairoSpeculationFinish(&window->speculation, &buffer->cairo);
+    traceBegin(&menu->trace, TRACE_PAINT);
     if (!window->render(&buffer->cairo, menu)) return false;
     cairo_surface_flush(buffer->cairo.surface);
+    traceEnd(&menu->trace, TRACE_PAINT, 0);
+    latencyPainted(&menu->latency);
+    presentBuffer(window, buffer);
     XFlush(window->display);
+    latencyCommit(&menu->latency, NULL);
+    traceEnd(&menu->trace, TRACE_RENDER, buffer->height);
+
+    /* Nothing is shown yet, put the rest of the delay to use. */
+    cairoSpeculationStart(&window->speculation, &buffer->cairo, menu, window->width, window->root.h);
+
+    if (menu->debug && !traceIsRunning(&menu->trace))
+    {
+        debugMsg(true, "Frame presented with %s.", buffer->image ? (buffer->shared ? "MIT-SHM" : "XPutImage") : "Xlib surface");
+    }
 
     return true;
 }
@@ -494,19 +769,21 @@ cleanup(X11* x11)
 {
     assert(x11);
 
-    destroyBuffer(&x11->window.buffer);
+    cairoSpeculationFinish(&x11->window.speculation, NULL);
+    destroyBuffer(&x11->window, &x11->window.buffer);
+    if (x11->window.gc) XFreeGC(x11->window.display, x11->window.gc);
+    cacheFree(&x11->window.cellCache);
+    cacheFree(&x11->window.chromeCache);
+    cairoTilesFree(&x11->window.tiles);
+    keyTableFree(&x11->window.keyTable);
+    if (x11->window.xic) XDestroyIC(x11->window.xic);
+    if (x11->window.xim) XCloseIM(x11->window.xim);
+    if (x11->window.delayFd >= 0) close(x11->window.delayFd);
     XUngrabKey(x11->window.display, AnyKey, AnyModifier, DefaultRootWindow(x11->window.display));
     XSync(x11->window.display, False);
     XCloseDisplay(x11->window.display);
 }
 
-static void
-cleanupAsync(void* xp)
-{
-    X11* x11 = (X11*)xp;
-    close(ConnectionNumber(x11->dispaly));
-}
-
 static bool
 grabfocus(X11* x11, X11Window* window)
 {
@@ -529,6 +806,19 @@ grabfocus(X11* x11, X11Window* window)
     return false;
 }
 
+static void
+ungrabkeyboard(void* xp)
+{
+    X11*       x11    = (X11*)xp;
+    X11Window* window = &x11->window;
+
+    if (!window->grabbed) return;
+
+    XUngrabKeyboard(window->display, CurrentTime);
+    XFlush(window->display);
+    window->grabbed = false;
+}
+
 static bool
 grabkeyboard(X11* x11, X11Window* window)
 {
@@ -548,6 +838,7 @@ grabkeyboard(X11* x11, X11Window* window)
                 GrabModeAsync,
                 CurrentTime) == GrabSuccess)
         {
+            window->grabbed = true;
             return true;
         }
         nanosleep(&ts, NULL);
@@ -590,11 +881,14 @@ maskedLookupString(
 {
     assert(xic), assert(keyEvent), assert(buffer), assert(keysym);
 
-    Status       status;
-    unsigned int state = keyEvent->state;
+    Status       status = XLookupBoth;
+    unsigned int state  = keyEvent->state;
+    int          len    = 0;
 
+    /* Without an input context, Xlib's own lookup still covers plain keys. */
     keyEvent->state &= mask;
-    int len         = XmbLookupString(*xic, keyEvent, buffer, size, keysym, &status);
+    if (*xic) len = XmbLookupString(*xic, keyEvent, buffer, size, keysym, &status);
+    else len = XLookupString(keyEvent, buffer, size, keysym, NULL);
     keyEvent->state = state;
 
     if (status == XLookupNone || status == XBufferOverflow) return 0;
@@ -631,25 +925,17 @@ handleMysteryKeypress(Menu* menu, KeySym keysym, char* reprBuf, size_t reprBufSi
     return len;
 }
 
-static size_t
-setKeyRepr(
-    X11Window* window,
-    Menu*      menu,
-    XKeyEvent* keyEvent,
-    Key*       key,
-    KeySym*    keysym,
-    char*      reprBuf,
-    size_t     reprBufSize)
+/* Translate a key event into the entry the key table keeps for it. */
+static void
+translateKey(X11Window* window, Menu* menu, XKeyEvent* keyEvent, KeyTableEntry* entry)
 {
-    assert(window), assert(menu), assert(keyEvent), assert(key), assert(keysym);
-    assert(reprBuf), assert(reprBufSize > 0);
+    assert(window), assert(menu), assert(keyEvent), assert(entry);
 
-    KeySym       aKeysym;
-    KeySym       bKeysym;
-    unsigned int state        = keyEvent->state;
-    int          reprLen      = 0;
-    char         aBuffer[128] = { 0 };
-    int          aLen         = maskedLookupString(
+    KeySym aKeysym;
+    KeySym bKeysym;
+    int    reprLen      = 0;
+    char   aBuffer[128] = { 0 };
+    int    aLen         = maskedLookupString(
         &window->xic,
         keyEvent,
         aBuffer,
@@ -666,45 +952,44 @@ setKeyRepr(
         &bKeysym,
         ~(ShiftMask | ControlMask));
 
-    if (IsModifierKey(aKeysym) || IsModifierKey(bKeysym)) return 0;
-    if (shiftIsSignificant(aBuffer, aLen, bBuffer, bLen))
-    {
-        reprLen = aLen;
-        *keysym = aKeysym;
-        state &= ~(ShiftMask);
-    }
-    else
-    {
-        reprLen = bLen;
-        *keysym = bKeysym;
-    }
+    entry->keycode    = keyEvent->keycode;
+    entry->state      = keyEvent->state;
+    entry->group      = 0;
+    entry->keysym     = NoSymbol;
+    entry->special    = SPECIAL_KEY_NONE;
+    entry->reprLength = 0;
+    entry->repr[0]    = '\0';
 
-    key->special    = getSpecialKey(*keysym);
-    size_t finalLen = 0;
+    if (IsModifierKey(aKeysym) || IsModifierKey(bKeysym)) return;
 
-    if (isNormalKey(reprLen > 0 ? (shiftIsSignificant(aBuffer, aLen, bBuffer, bLen) ? aBuffer : bBuffer) : "", reprLen))
+    entry->shiftConsumed = shiftIsSignificant(aBuffer, aLen, bBuffer, bLen);
+    reprLen              = entry->shiftConsumed ? aLen : bLen;
+    entry->keysym        = entry->shiftConsumed ? aKeysym : bKeysym;
+    entry->special       = getSpecialKey(entry->keysym);
+
+    char*  repr     = entry->repr;
+    size_t reprSize = sizeof(entry->repr);
+
+    if (isNormalKey(reprLen > 0 ? (entry->shiftConsumed ? aBuffer : bBuffer) : "", reprLen))
     {
-        const char* src = shiftIsSignificant(aBuffer, aLen, bBuffer, bLen) ? aBuffer : bBuffer;
-        finalLen        = (size_t)reprLen;
-        if (finalLen >= reprBufSize) finalLen = reprBufSize - 1;
-        memcpy(reprBuf, src, finalLen);
-        reprBuf[finalLen] = '\0';
+        const char* src   = entry->shiftConsumed ? aBuffer : bBuffer;
+        entry->reprLength = (size_t)reprLen;
+        if (entry->reprLength >= reprSize) entry->reprLength = reprSize - 1;
+        memcpy(repr, src, entry->reprLength);
+        repr[entry->reprLength] = '\0';
     }
-    else if (key->special != SPECIAL_KEY_NONE)
+    else if (entry->special != SPECIAL_KEY_NONE)
     {
-        const char* specialRepr = specialKeyRepr(key->special);
-        finalLen                = strlen(specialRepr);
-        if (finalLen >= reprBufSize) finalLen = reprBufSize - 1;
-        memcpy(reprBuf, specialRepr, finalLen);
-        reprBuf[finalLen] = '\0';
+        const char* specialRepr = specialKeyRepr(entry->special);
+        entry->reprLength       = strlen(specialRepr);
+        if (entry->reprLength >= reprSize) entry->reprLength = reprSize - 1;
+        memcpy(repr, specialRepr, entry->reprLength);
+        repr[entry->reprLength] = '\0';
     }
     else
     {
-        finalLen = handleMysteryKeypress(menu, *keysym, reprBuf, reprBufSize);
+        entry->reprLength = handleMysteryKeypress(menu, entry->keysym, repr, reprSize);
     }
-
-    setKeyMods(key, state);
-    return finalLen;
 }
 
 static Key
@@ -718,11 +1003,36 @@ makeKeyFromEvent(
     size_t*    outReprLen)
 {
     assert(window), assert(keyEvent), assert(keysym), assert(reprBuf), assert(outReprLen);
+    assert(reprBufSize > 0);
 
     Key key = { 0 };
     keyInit(&key);
-    *outReprLen = setKeyRepr(window, menu, keyEvent, &key, keysym, reprBuf, reprBufSize);
-    key.repr    = (String){ .data = reprBuf, .length = *outReprLen };
+
+    /* Input methods deliver composed text with a keycode of 0, which says
+     * nothing about the next event, so only real keycodes are kept. */
+    KeyTableEntry        translated = { 0 };
+    const KeyTableEntry* entry      = NULL;
+    if (keyEvent->keycode)
+    {
+        entry = keyTableLookup(&window->keyTable, keyEvent->keycode, keyEvent->state, 0);
+    }
+    if (!entry)
+    {
+        translateKey(window, menu, keyEvent, &translated);
+        if (keyEvent->keycode) keyTableInsert(&window->keyTable, &translated);
+        entry = &translated;
+    }
+
+    size_t len = entry->reprLength;
+    if (len >= reprBufSize) len = reprBufSize - 1;
+    memcpy(reprBuf, entry->repr, len);
+    reprBuf[len] = '\0';
+
+    *keysym     = entry->keysym;
+    *outReprLen = len;
+    key.special = entry->special;
+    key.repr    = (String){ .data = reprBuf, .length = len };
+    if (len > 0) setKeyMods(&key, entry->shiftConsumed ? keyEvent->state & ~(ShiftMask) : keyEvent->state);
 
     return key;
 }
@@ -738,12 +1048,72 @@ keypress(X11Window* window, Menu* menu, XKeyEvent* keyEvent)
     Key    key          = makeKeyFromEvent(window, menu, keyEvent, &keysym, reprBuf, sizeof(reprBuf), &reprLen);
     if (stringIsEmpty(&key.repr)) return MENU_STATUS_RUNNING;
 
+    traceInstant(&menu->trace, TRACE_KEY, keyEvent->keycode);
+    latencyKey(&menu->latency, keyEvent->time);
     MenuStatus status = menuHandleKeypress(menu, &key);
+    latencyHandled(&menu->latency, status == MENU_STATUS_DAMAGED);
 
     keyFree(&key);
     return status;
 }
 
+/* Sleep until the X connection is readable, the menu delay or the +keep
+ * deadline runs out, or a sync command exits. Returns false if polling
+ * failed. */
+static bool
+waitForEvent(X11Window* window, Menu* menu, bool* delayExpired)
+{
+    assert(window), assert(menu), assert(delayExpired);
+
+    uint32_t delay     = menuDelayRemaining(menu);
+    uint32_t remaining = menuWaitRemaining(menu);
+    int      timeout   = -1;
+
+    *delayExpired = false;
+
+    if (remaining && window->delayFd >= 0)
+    {
+        struct itimerspec its = {
+            .it_interval.tv_sec  = 0,
+            .it_interval.tv_nsec = 0,
+            .it_value.tv_sec     = remaining / 1000,
+            .it_value.tv_nsec    = (remaining % 1000) * 1000000,
+        };
+        timerfd_settime(window->delayFd, 0, &its, NULL);
+    }
+    else if (remaining)
+    {
+        /* No timer available, let poll time out instead. */
+        timeout = (int)remaining;
+    }
+
+    /* poll skips the timer entry if it could not be created, and the command
+     * entry unless a sync command is running. */
+    struct pollfd fds[] = {
+        { .fd = ConnectionNumber(window->display), .events = POLLIN },
+        { .fd = window->delayFd,                   .events = POLLIN },
+        { .fd = menuCommandFd(menu),               .events = POLLIN },
+    };
+
+    traceBegin(&menu->trace, TRACE_WAIT);
+    int ready = poll(fds, 3, timeout);
+    traceEnd(&menu->trace, TRACE_WAIT, ready);
+    if (ready < 0 && errno != EINTR) return false;
+
+    if (ready > 0 && (fds[1].revents & POLLIN))
+    {
+        uint64_t expirations;
+        if (read(window->delayFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return false;
+    }
+
+    if (ready > 0 && (fds[2].revents & POLLIN)) menuContinueCommands(menu);
+
+    /* The timer also wakes up for the +keep deadline, only report the delay. */
+    *delayExpired = delay && !menuDelayRemaining(menu);
+
+    return true;
+}
+
 static int
 eventHandler(X11* x11, X11Window* window, Menu* menu)
 {
@@ -753,11 +1123,41 @@ eventHandler(X11* x11, X11Window* window, Menu* menu)
 
     while (true)
     {
-        render(window, menu);
+        traceCheckDump(&menu->trace);
+
+        /* The +keep deadline passed, take the keyboard back. */
+        if (menuKeepExpired(menu) && !window->grabbed && !grabkeyboard(x11, window)) return EX_SOFTWARE;
 
-        if (menuIsDelayed(menu) && XPending(window->display) == 0)
+        if (XPending(window->display) == 0)
         {
-            usleep(1000);
+            /* Every queued event has been handled, draw the outcome once
+             * instead of each level a burst of keys passed through. */
+            if (window->damaged)
+            {
+                window->damaged = false;
+                if (!render(window, menu)) return EX_SOFTWARE;
+                continue;
+            }
+
+            /* Nothing is queued, draw what the most used prefixes of this
+             * level show before going to sleep. */
+            if (window->prefetched != menu->keyChords && window->buffer.created)
+            {
+                window->prefetched = menu->keyChords;
+                cairoPrefetch(&window->buffer.cairo, menu, window->width, window->root.h);
+                continue;
+            }
+
+            bool delayExpired = false;
+            if (!waitForEvent(window, menu, &delayExpired))
+            {
+                cleanup(x11);
+                errorMsg("Could not wait for X11 events.");
+                return EX_SOFTWARE;
+            }
+
+            /* The menu was held back by the delay, show it now. */
+            if (delayExpired && !render(window, menu)) return EX_SOFTWARE;
             continue;
         }
 
@@ -775,8 +1175,19 @@ eventHandler(X11* x11, X11Window* window, Menu* menu)
         }
         case Expose:
         {
-            if (ev.xexpose.count == 0)
-                if (!render(window, menu)) return EX_SOFTWARE;
+            /* Collect the exposed areas and redraw them once the queue is
+             * empty. */
+            if (window->buffer.created)
+            {
+                cairo_rectangle_int_t rect = {
+                    .x      = ev.xexpose.x,
+                    .y      = ev.xexpose.y,
+                    .width  = ev.xexpose.width,
+                    .height = ev.xexpose.height,
+                };
+                cairoInvalidate(&window->buffer.cairo, &rect);
+            }
+            if (ev.xexpose.count == 0) window->damaged = true;
             break;
         }
         case FocusIn:
@@ -790,35 +1201,22 @@ eventHandler(X11* x11, X11Window* window, Menu* menu)
         }
         case KeyPress:
         {
-            /* Ungrab keyboard before processing keypress */
-            XUngrabKeyboard(window->display, CurrentTime);
-            XFlush(window->display);
-
+            /* The grab is held across keypresses. The menu only releases
+             * it to run a command, see ungrabkeyboard. */
             MenuStatus status = keypress(window, menu, &ev.xkey);
 
-            /* Regrab keyboard if menu is still running */
             switch (status)
             {
             case MENU_STATUS_RUNNING:
             case MENU_STATUS_DAMAGED:
-                /* Menu is still active, regrab keyboard */
-                if (XGrabKeyboard(
-                        window->display,
-                        DefaultRootWindow(window->display),
-                        True,
-                        GrabModeAsync,
-                        GrabModeAsync,
-                        CurrentTime) != GrabSuccess)
+                /* Menu is still active, regrab keyboard after a +keep command
+                 * unless the command's deadline is still running. */
+                if (!window->grabbed && !menu->keepPending && !grabkeyboard(x11, window))
                 {
-                    cleanup(x11);
-                    errorMsg("Could not regrab keyboard after keypress.");
                     return EX_SOFTWARE;
                 }
 
-                if (status == MENU_STATUS_DAMAGED)
-                {
-                    if (!render(window, menu)) return EX_SOFTWARE;
-                }
+                if (status == MENU_STATUS_DAMAGED) window->damaged = true;
                 break;
             case MENU_STATUS_EXIT_OK: return EX_OK;
             case MENU_STATUS_EXIT_SOFTWARE: return EX_SOFTWARE;
@@ -826,6 +1224,13 @@ eventHandler(X11* x11, X11Window* window, Menu* menu)
             break;
         }
         case ButtonPress: return EX_SOFTWARE;
+        case MappingNotify:
+        {
+            /* Translations made with the old keymap no longer hold. */
+            XRefreshKeyboardMapping(&ev.xmapping);
+            if (ev.xmapping.request == MappingKeyboard) keyTableClear(&window->keyTable);
+            break;
+        }
         case VisibilityNotify:
         {
             if (ev.xvisibility.state != VisibilityUnobscured)
@@ -846,16 +1251,22 @@ x11Run(Menu* menu)
 {
     assert(menu);
 
-    int result = EX_SOFTWARE;
+    int             result = EX_SOFTWARE;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
     checkLocale(menu);
     X11 x11         = { 0 };
     x11.menu        = menu;
-    menu->cleanupfp = cleanupAsync;
-    menu->xp        = &x11;
+    menu->ungrabfp = ungrabkeyboard;
+    menu->xp       = &x11;
     if (!initX11(&x11, &x11.window, menu)) return result;
     grabkeyboard(&x11, &x11.window);
     if (render(&x11.window, menu))
     {
+        if (!menuIsDelayed(menu)) debugMsg(menu->debug, "First frame in %.2f ms.", elapsedMs(&start));
+        traceBegin(&menu->trace, TRACE_INPUT_METHOD);
+        initInputMethod(&x11.window, menu);
+        traceEnd(&menu->trace, TRACE_INPUT_METHOD, x11.window.xic != NULL);
         result = eventHandler(&x11, &x11.window, menu);
     }
     cleanup(&x11);
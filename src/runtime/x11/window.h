@@ -2,27 +2,36 @@
 #define WK_X11_WINDOW_H_
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
 #include <stdbool.h>
 #include <stdint.h>
 
 #include "../cairo.h"
+#include "../key_table.h"
 
 typedef struct
 {
-    Cairo    cairo;
-    uint32_t width;
-    uint32_t height;
-    bool     created;
+    Cairo           cairo;
+    XImage*         image;
+    XShmSegmentInfo shm;
+    uint32_t        width;
+    uint32_t        height;
+    bool            shared;
+    bool            created;
 } Buffer;
 
 typedef struct
 {
     Display* display;
+    int      delayFd;
     int32_t  screen;
     Drawable drawable;
     XIM      xim;
     XIC      xic;
     Visual*  visual;
+    int      depth;
+    GC       gc;
     KeySym   keysym;
     uint32_t mods;
     Buffer   buffer;
@@ -35,11 +44,21 @@ typedef struct
     float    widthFactor;
     uint32_t displayed;
     int32_t  monitor;
+    bool     grabbed;
+    bool     damaged;
+    bool     clientRender;
+    bool     shmAvailable;
     struct display
     {
         uint32_t x, y, w, h;
     } root;
-    CairoPaint paint;
+    CairoPaint       paint;
+    Cache            cellCache;
+    Cache            chromeCache;
+    CairoTiles       tiles;
+    CairoSpeculation speculation;
+    KeyTable         keyTable;
+    Span*            prefetched;
     bool (*render)(Cairo* cairo, Menu* menu);
 } X11Window;
 
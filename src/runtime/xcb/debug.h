@@ -0,0 +1,8 @@
+#ifndef WK_XCB_DEBUG_H_
+#define WK_XCB_DEBUG_H_
+
+#include "window.h"
+
+void disassembleXcbWindow(XcbWindow* window);
+
+#endif /* WK_XCB_DEBUG_H_ */
@@ -0,0 +1,1202 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <locale.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <sysexits.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cairo-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xinerama.h>
+#include <xcb/xproto.h>
+#include <xkbcommon/xkbcommon-keysyms.h>
+#include <xkbcommon/xkbcommon-x11.h>
+#include <xkbcommon/xkbcommon.h>
+
+/* common includes */
+#include "common/common.h"
+#include "common/debug.h"
+#include "common/key_chord.h"
+#include "common/latency.h"
+#include "common/menu.h"
+#include "common/trace.h"
+
+/* runtime includes */
+#include "common/string.h"
+#include "runtime/cairo.h"
+#include "runtime/common.h"
+#include "runtime/key_table.h"
+
+/* local includes */
+#include "debug.h"
+#include "window.h"
+
+typedef struct
+{
+    SpecialKey   special;
+    xkb_keysym_t keysym;
+} XcbSpecialKey;
+
+static const XcbSpecialKey specialkeys[] = {
+    { SPECIAL_KEY_NONE,           XKB_KEY_NoSymbol             },
+    { SPECIAL_KEY_LEFT,           XKB_KEY_Left                 },
+    { SPECIAL_KEY_LEFT,           XKB_KEY_KP_Left              },
+    { SPECIAL_KEY_RIGHT,          XKB_KEY_Right                },
+    { SPECIAL_KEY_RIGHT,          XKB_KEY_KP_Right             },
+    { SPECIAL_KEY_UP,             XKB_KEY_Up                   },
+    { SPECIAL_KEY_UP,             XKB_KEY_KP_Up                },
+    { SPECIAL_KEY_DOWN,           XKB_KEY_Down                 },
+    { SPECIAL_KEY_DOWN,           XKB_KEY_KP_Down              },
+    { SPECIAL_KEY_TAB,            XKB_KEY_Tab                  },
+    { SPECIAL_KEY_TAB,            XKB_KEY_KP_Tab               },
+    { SPECIAL_KEY_SPACE,          XKB_KEY_space                },
+    { SPECIAL_KEY_SPACE,          XKB_KEY_KP_Space             },
+    { SPECIAL_KEY_RETURN,         XKB_KEY_Return               },
+    { SPECIAL_KEY_RETURN,         XKB_KEY_KP_Enter             },
+    { SPECIAL_KEY_DELETE,         XKB_KEY_Delete               },
+    { SPECIAL_KEY_DELETE,         XKB_KEY_KP_Delete            },
+    { SPECIAL_KEY_BS,             XKB_KEY_BackSpace            },
+    { SPECIAL_KEY_ESCAPE,         XKB_KEY_Escape               },
+    { SPECIAL_KEY_HOME,           XKB_KEY_Home                 },
+    { SPECIAL_KEY_HOME,           XKB_KEY_KP_Home              },
+    { SPECIAL_KEY_PAGE_UP,        XKB_KEY_Page_Up              },
+    { SPECIAL_KEY_PAGE_UP,        XKB_KEY_KP_Page_Up           },
+    { SPECIAL_KEY_PAGE_DOWN,      XKB_KEY_Page_Down            },
+    { SPECIAL_KEY_PAGE_DOWN,      XKB_KEY_KP_Page_Down         },
+    { SPECIAL_KEY_END,            XKB_KEY_End                  },
+    { SPECIAL_KEY_END,            XKB_KEY_KP_End               },
+    { SPECIAL_KEY_BEGIN,          XKB_KEY_Begin                },
+    { SPECIAL_KEY_BEGIN,          XKB_KEY_KP_Begin             },
+    { SPECIAL_KEY_F1,             XKB_KEY_F1                   },
+    { SPECIAL_KEY_F2,             XKB_KEY_F2                   },
+    { SPECIAL_KEY_F3,             XKB_KEY_F3                   },
+    { SPECIAL_KEY_F4,             XKB_KEY_F4                   },
+    { SPECIAL_KEY_F5,             XKB_KEY_F5                   },
+    { SPECIAL_KEY_F6,             XKB_KEY_F6                   },
+    { SPECIAL_KEY_F7,             XKB_KEY_F7                   },
+    { SPECIAL_KEY_F8,             XKB_KEY_F8                   },
+    { SPECIAL_KEY_F9,             XKB_KEY_F9                   },
+    { SPECIAL_KEY_F10,            XKB_KEY_F10                  },
+    { SPECIAL_KEY_F11,            XKB_KEY_F11                  },
+    { SPECIAL_KEY_F12,            XKB_KEY_F12                  },
+    { SPECIAL_KEY_F13,            XKB_KEY_F13                  },
+    { SPECIAL_KEY_F14,            XKB_KEY_F14                  },
+    { SPECIAL_KEY_F15,            XKB_KEY_F15                  },
+    { SPECIAL_KEY_F16,            XKB_KEY_F16                  },
+    { SPECIAL_KEY_F17,            XKB_KEY_F17                  },
+    { SPECIAL_KEY_F18,            XKB_KEY_F18                  },
+    { SPECIAL_KEY_F19,            XKB_KEY_F19                  },
+    { SPECIAL_KEY_F20,            XKB_KEY_F20                  },
+    { SPECIAL_KEY_F21,            XKB_KEY_F21                  },
+    { SPECIAL_KEY_F22,            XKB_KEY_F22                  },
+    { SPECIAL_KEY_F23,            XKB_KEY_F23                  },
+    { SPECIAL_KEY_F24,            XKB_KEY_F24                  },
+    { SPECIAL_KEY_F25,            XKB_KEY_F25                  },
+    { SPECIAL_KEY_F26,            XKB_KEY_F26                  },
+    { SPECIAL_KEY_F27,            XKB_KEY_F27                  },
+    { SPECIAL_KEY_F28,            XKB_KEY_F28                  },
+    { SPECIAL_KEY_F29,            XKB_KEY_F29                  },
+    { SPECIAL_KEY_F30,            XKB_KEY_F30                  },
+    { SPECIAL_KEY_F31,            XKB_KEY_F31                  },
+    { SPECIAL_KEY_F32,            XKB_KEY_F32                  },
+    { SPECIAL_KEY_F33,            XKB_KEY_F33                  },
+    { SPECIAL_KEY_F34,            XKB_KEY_F34                  },
+    { SPECIAL_KEY_F35,            XKB_KEY_F35                  },
+    /* XF86 keys */
+    { SPECIAL_KEY_AUDIO_VOL_DOWN, XKB_KEY_XF86AudioLowerVolume },
+    { SPECIAL_KEY_AUDIO_VOL_MUTE, XKB_KEY_XF86AudioMute        },
+    { SPECIAL_KEY_AUDIO_VOL_UP,   XKB_KEY_XF86AudioRaiseVolume },
+    { SPECIAL_KEY_AUDIO_PLAY,     XKB_KEY_XF86AudioPlay        },
+    { SPECIAL_KEY_AUDIO_STOP,     XKB_KEY_XF86AudioStop        },
+    { SPECIAL_KEY_AUDIO_PREV,     XKB_KEY_XF86AudioPrev        },
+    { SPECIAL_KEY_AUDIO_NEXT,     XKB_KEY_XF86AudioNext        },
+};
+
+static const size_t specialkeysLen = sizeof(specialkeys) / sizeof(specialkeys[0]);
+
+/* Requests whose replies are only needed once the window exists. They are
+ * all sent before the first reply is read, so they share one round trip. */
+typedef struct
+{
+    xcb_xinerama_query_screens_cookie_t screens;
+    xcb_get_input_focus_cookie_t        focus;
+    xcb_query_pointer_cookie_t          pointer;
+    xcb_grab_keyboard_cookie_t          grab;
+} StartupCookies;
+
+static void
+checkLocale(Menu* menu)
+{
+    assert(menu);
+
+    if (!setlocale(LC_CTYPE, ""))
+    {
+        warnMsg("Locale not supported.");
+    }
+    debugMsg(menu->debug, "Locale supported.");
+}
+
+static cairo_surface_t*
+getThrowawaySurface(XcbWindow* window)
+{
+    assert(window);
+
+    return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, window->width, window->height);
+}
+
+static bool
+desiriedPos(Menu* menu, MenuPosition pos)
+{
+    assert(menu);
+
+    return menu->position == pos;
+}
+
+static void
+resizeWinWidth(XcbWindow* window, Menu* menu)
+{
+    assert(menu), assert(window);
+
+    int32_t         windowWidth = menu->menuWidth;
+    struct display* root        = &window->root;
+    if (windowWidth < 0)
+    {
+        /* set width to half the size of the screen */
+        window->x     = root->x + (root->w / 4);
+        window->width = root->w / 2;
+    }
+    else if (windowWidth == 0 || (uint32_t)windowWidth > root->w)
+    {
+        /* make the window as wide as the screen */
+        window->x     = root->x;
+        window->width = root->w;
+    }
+    else
+    {
+        /* set the width to the desired user setting */
+        window->x     = root->x + ((root->w - windowWidth) / 2); /* position in the middle */
+        window->width = windowWidth;
+    }
+}
+
+static void
+resizeWinHeight(XcbWindow* window, Menu* menu)
+{
+    assert(window), assert(menu);
+
+    int32_t         windowGap = menu->menuGap;
+    struct display* root      = &window->root;
+    window->maxHeight         = root->h;
+
+    if (windowGap < 0)
+    {
+        /* user wants a 1/10th gap between edge of screen and window*/
+        window->y = (root->h / 10);
+    }
+    else if (windowGap == 0 || (uint32_t)windowGap > root->h)
+    {
+        /* user has no gap, or it is too large for the screen */
+        window->y = root->y;
+    }
+    else
+    {
+        /* position window with desired gap, if any */
+        window->y = root->y + windowGap;
+    }
+
+    /* sanity check that window is not too big */
+    if (window->height >= root->h)
+    {
+        window->y      = 0;
+        window->height = root->h;
+    }
+
+    if (desiriedPos(menu, MENU_POS_BOTTOM))
+    {
+        window->y = root->h - window->height - window->y + root->y;
+    }
+    else if (desiriedPos(menu, MENU_POS_CENTER))
+    {
+        window->y = root->y + (root->h - window->height) / 2;
+    }
+}
+
+static void
+resizeWindow(XcbWindow* window, Menu* menu)
+{
+    assert(window), assert(menu);
+
+    resizeWinWidth(window, menu);
+    resizeWinHeight(window, menu);
+}
+
+static void
+moveResizeWindow(XcbWindow* window)
+{
+    assert(window);
+
+    const uint32_t values[] = { window->x, window->y, window->width, window->height };
+    xcb_configure_window(
+        window->connection,
+        window->drawable,
+        XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+        values);
+}
+
+static void
+sendStartupRequests(XcbWindow* window, StartupCookies* cookies)
+{
+    assert(window), assert(cookies);
+
+    xcb_connection_t* connection = window->connection;
+    xcb_window_t      root       = window->screen->root;
+
+    cookies->screens = xcb_xinerama_query_screens(connection);
+    cookies->focus   = xcb_get_input_focus(connection);
+    cookies->pointer = xcb_query_pointer(connection, root);
+    cookies->grab    = xcb_grab_keyboard(
+        connection,
+        1,
+        root,
+        XCB_CURRENT_TIME,
+        XCB_GRAB_MODE_ASYNC,
+        XCB_GRAB_MODE_ASYNC);
+}
+
+/* Find the top-level window holding the input focus and its geometry. This is
+ * the only part of startup that needs dependent round trips. */
+static bool
+getFocusGeometry(XcbWindow* window, xcb_window_t focus, xcb_get_geometry_reply_t* geometry)
+{
+    assert(window), assert(geometry);
+
+    xcb_connection_t* connection = window->connection;
+    xcb_window_t      root       = window->screen->root;
+
+    if (focus == root || focus == XCB_INPUT_FOCUS_POINTER_ROOT || focus == XCB_NONE) return false;
+
+    xcb_window_t w = focus;
+    while (true)
+    {
+        xcb_query_tree_reply_t* tree = xcb_query_tree_reply(
+            connection,
+            xcb_query_tree(connection, w),
+            NULL);
+        if (!tree) return false;
+
+        xcb_window_t parent = tree->parent;
+        free(tree);
+        if (parent == root || parent == XCB_NONE) break;
+        w = parent;
+    }
+
+    xcb_get_geometry_reply_t* reply = xcb_get_geometry_reply(
+        connection,
+        xcb_get_geometry(connection, w),
+        NULL);
+    if (!reply) return false;
+
+    *geometry = *reply;
+    free(reply);
+    return true;
+}
+
+static void
+setMonitor(XcbWindow* window, Menu* menu, StartupCookies* cookies)
+{
+    assert(window), assert(menu), assert(cookies);
+
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define INTERSECT(x, y, w, h, r)                                            \
+    (MAX(0, MIN((x) + (w), (r).x_org + (r).width) - MAX((x), (r).x_org)) && \
+     MAX(0, MIN((y) + (h), (r).y_org + (r).height) - MAX((y), (r).y_org)))
+
+    xcb_connection_t*                   connection = window->connection;
+    xcb_xinerama_query_screens_reply_t* screens    = xcb_xinerama_query_screens_reply(
+        connection,
+        cookies->screens,
+        NULL);
+    xcb_get_input_focus_reply_t* focus = xcb_get_input_focus_reply(
+        connection,
+        cookies->focus,
+        NULL);
+    xcb_query_pointer_reply_t* pointer = xcb_query_pointer_reply(
+        connection,
+        cookies->pointer,
+        NULL);
+
+    int32_t                     n    = screens ? xcb_xinerama_query_screens_screen_info_length(screens) : 0;
+    xcb_xinerama_screen_info_t* info = screens ? xcb_xinerama_query_screens_screen_info(screens) : NULL;
+    if (n > 0)
+    {
+        int32_t                  a, j, i = 0, area = 0;
+        xcb_get_geometry_reply_t geometry;
+
+        /* find xinerama screen with which the focused window intersects most */
+        if (focus && getFocusGeometry(window, focus->focus, &geometry))
+        {
+            for (j = 0; j < n; j++)
+            {
+                a = INTERSECT(geometry.x, geometry.y, geometry.width, geometry.height, info[j]);
+                if (a > area)
+                {
+                    area = a;
+                    i    = j;
+                }
+            }
+        }
+
+        /* no focused window is on screen, so use pointer location instead */
+        if (!area && pointer)
+        {
+            for (i = 0; i < n; i++)
+            {
+                if (INTERSECT(pointer->root_x, pointer->root_y, 1, 1, info[i]) > 0) break;
+            }
+            if (i == n) i = 0;
+        }
+
+        window->root.x = info[i].x_org;
+        window->root.y = info[i].y_org;
+        window->root.w = info[i].width;
+        window->root.h = info[i].height;
+    }
+    else
+    {
+        window->root.x = 0;
+        window->root.y = 0;
+        window->root.w = window->screen->width_in_pixels;
+        window->root.h = window->screen->height_in_pixels;
+    }
+
+    free(screens);
+    free(focus);
+    free(pointer);
+
+#undef INTERSECT
+#undef MIN
+#undef MAX
+
+    window->height = cairoHeight(menu, getThrowawaySurface(window), window->root.h);
+    resizeWindow(window, menu);
+    moveResizeWindow(window);
+}
+
+/* Pick a 32 bit TrueColor visual for transparency, otherwise the root one. */
+static void
+setVisual(XcbWindow* window)
+{
+    assert(window);
+
+    xcb_screen_t* screen = window->screen;
+    window->depth        = screen->root_depth;
+    window->visual       = NULL;
+
+    for (xcb_depth_iterator_t d = xcb_screen_allowed_depths_iterator(screen); d.rem; xcb_depth_next(&d))
+    {
+        for (xcb_visualtype_iterator_t v = xcb_depth_visuals_iterator(d.data); v.rem; xcb_visualtype_next(&v))
+        {
+            if (d.data->depth == 32 && v.data->_class == XCB_VISUAL_CLASS_TRUE_COLOR)
+            {
+                window->depth  = 32;
+                window->visual = v.data;
+                return;
+            }
+            if (v.data->visual_id == screen->root_visual && !window->visual) window->visual = v.data;
+        }
+    }
+}
+
+static bool
+initKeymap(XcbWindow* window)
+{
+    assert(window);
+
+    XcbXkb* xkb = &window->xkb;
+
+    struct xkb_keymap* keymap = xkb_x11_keymap_new_from_device(
+        xkb->context,
+        window->connection,
+        xkb->deviceId,
+        XKB_KEYMAP_COMPILE_NO_FLAGS);
+    if (!keymap)
+    {
+        errorMsg("Failed to compile keymap.");
+        return false;
+    }
+
+    struct xkb_state* state = xkb_x11_state_new_from_device(keymap, window->connection, xkb->deviceId);
+    if (!state)
+    {
+        errorMsg("Failed to create XKB state.");
+        xkb_keymap_unref(keymap);
+        return false;
+    }
+
+    xkb_state_unref(xkb->state);
+    xkb_keymap_unref(xkb->keymap);
+    xkb->keymap = keymap;
+    xkb->state  = state;
+    keyTableClear(&window->keyTable);
+    return true;
+}
+
+static bool
+initXkb(XcbWindow* window)
+{
+    assert(window);
+
+    XcbXkb* xkb = &window->xkb;
+
+    if (!xkb_x11_setup_xkb_extension(
+            window->connection,
+            XKB_X11_MIN_MAJOR_XKB_VERSION,
+            XKB_X11_MIN_MINOR_XKB_VERSION,
+            XKB_X11_SETUP_XKB_EXTENSION_NO_FLAGS,
+            NULL,
+            NULL,
+            NULL,
+            NULL))
+    {
+        errorMsg("The X server does not support XKB.");
+        return false;
+    }
+
+    if (!(xkb->context = xkb_context_new(XKB_CONTEXT_NO_FLAGS))) return false;
+    if ((xkb->deviceId = xkb_x11_get_core_keyboard_device_id(window->connection)) < 0) return false;
+
+    return initKeymap(window);
+}
+
+static void
+initBuffer(XcbWindow* window)
+{
+    assert(window);
+
+    Buffer* buffer = &window->buffer;
+    memset(buffer, 0, sizeof(Buffer));
+}
+
+static bool
+initXcb(Xcb* xcb, XcbWindow* window, Menu* menu, StartupCookies* cookies)
+{
+    assert(xcb), assert(window), assert(menu), assert(cookies);
+
+    debugMsg(menu->debug, "Initializing xcb.");
+    int               screenNum  = 0;
+    xcb_connection_t* connection = window->connection = xcb->connection = xcb_connect(NULL, &screenNum);
+    if (xcb_connection_has_error(connection)) return false;
+    /* Commands are spawned without forking wk, keep them off the connection. */
+    fcntl(xcb_get_file_descriptor(connection), F_SETFD, FD_CLOEXEC);
+
+    xcb_screen_iterator_t iter = xcb_setup_roots_iterator(xcb_get_setup(connection));
+    for (int i = 0; i < screenNum && iter.rem; i++) xcb_screen_next(&iter);
+    if (!iter.rem) return false;
+
+    window->screen  = iter.data;
+    window->delayFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    window->width = window->height = 1;
+    window->border                 = menu->borderWidth;
+    initBuffer(window);
+    keyTableInit(&window->keyTable);
+    window->prefetched = NULL;
+    window->speculation.started = false;
+
+    /* Nothing below waits on the server until the XKB setup reads its reply,
+     * by which point the replies to these are in as well. */
+    sendStartupRequests(window, cookies);
+    setVisual(window);
+
+    uint32_t     valueMask = XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT | XCB_CW_EVENT_MASK;
+    uint32_t     values[5] = { 0 };
+    xcb_window_t root      = window->screen->root;
+    uint32_t     eventMask = XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS |
+                         XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_VISIBILITY_CHANGE;
+
+    if (window->depth == 32)
+    {
+        xcb_colormap_t colormap = xcb_generate_id(connection);
+        xcb_create_colormap(connection, XCB_COLORMAP_ALLOC_NONE, colormap, root, window->visual->visual_id);
+
+        valueMask = XCB_CW_BACK_PIXMAP | XCB_CW_BORDER_PIXEL | XCB_CW_OVERRIDE_REDIRECT |
+                    XCB_CW_EVENT_MASK | XCB_CW_COLORMAP;
+        values[0] = XCB_BACK_PIXMAP_NONE;
+        values[1] = 0;
+        values[2] = 1;
+        values[3] = eventMask;
+        values[4] = colormap;
+    }
+    else
+    {
+        values[0] = window->screen->black_pixel;
+        values[1] = 1;
+        values[2] = eventMask;
+    }
+
+    window->drawable = xcb_generate_id(connection);
+    xcb_create_window(
+        connection,
+        window->depth,
+        window->drawable,
+        root,
+        0,
+        0,
+        window->width,
+        window->height,
+        0,
+        XCB_WINDOW_CLASS_INPUT_OUTPUT,
+        window->visual ? window->visual->visual_id : window->screen->root_visual,
+        valueMask,
+        values);
+
+    static const char wmClass[] = "wk\0wk";
+    xcb_change_property(
+        connection,
+        XCB_PROP_MODE_REPLACE,
+        window->drawable,
+        XCB_ATOM_WM_CLASS,
+        XCB_ATOM_STRING,
+        8,
+        sizeof(wmClass),
+        wmClass);
+
+    if (!initXkb(window)) return false;
+
+    setMonitor(window, menu, cookies);
+    xcb_map_window(connection, window->drawable);
+    window->render = cairoPaint;
+    cairoPaintInit(menu, &window->paint);
+    cacheInit(&window->cellCache, CACHE_CELL_CAPACITY, menu->cache);
+    cacheInit(&window->chromeCache, CACHE_CHROME_CAPACITY, menu->cache);
+    cairoTilesInit(&window->tiles);
+    if (menu->debug) disassembleXcbWindow(window);
+    return true;
+}
+
+static void
+destroyBuffer(Buffer* buffer)
+{
+    assert(buffer);
+
+    cairoDestroy(&buffer->cairo);
+    memset(buffer, 0, sizeof(Buffer));
+}
+
+static bool
+createBuffer(XcbWindow* window, Buffer* buffer)
+{
+    assert(window), assert(buffer);
+
+    cairo_surface_t* surface = cairo_xcb_surface_create(
+        window->connection,
+        window->drawable,
+        window->visual,
+        window->width,
+        window->height);
+
+    if (!surface) goto fail;
+
+    cairo_xcb_surface_set_size(surface, window->width, window->height);
+    buffer->cairo.scale = 1;
+
+    if (!cairoCreateForSurface(&buffer->cairo, surface))
+    {
+        cairo_surface_destroy(surface);
+        goto fail;
+    }
+
+    buffer->cairo.paint       = &window->paint;
+    buffer->cairo.cellCache   = &window->cellCache;
+    buffer->cairo.chromeCache = &window->chromeCache;
+    buffer->cairo.tiles       = &window->tiles;
+    buffer->width             = window->width;
+    buffer->height            = window->height;
+    buffer->created           = true;
+    return true;
+
+fail:
+    destroyBuffer(buffer);
+    return false;
+}
+
+static Buffer*
+getBuffer(XcbWindow* window)
+{
+    assert(window);
+
+    Buffer* buffer = &window->buffer;
+
+    if (window->height != buffer->height) destroyBuffer(buffer);
+    if (!buffer->created && !createBuffer(window, buffer)) return NULL;
+
+    return buffer;
+}
+
+static bool
+render(XcbWindow* window, Menu* menu)
+{
+    assert(window), assert(menu);
+
+    uint32_t oldh  = window->height;
+    window->height = cairoHeight(menu, getThrowawaySurface(window), window->root.h);
+    resizeWinHeight(window, menu);
+
+    if (oldh != window->height) moveResizeWindow(window);
+
+    Buffer* buffer = getBuffer(window);
+    if (!buffer)
+    {
+        errorMsg("Could not get buffer while rendering.");
+        return false;
+    }
+
+    traceBegin(&menu->trace, TRACE_RENDER);
+
+    menu->width  = buffer->width;
+    menu->height = buffer->height;
+    if (!menuIsDelayed(menu)) cairoSpeculationFinish(&window->speculation, &buffer->cairo);
+    traceBegin(&menu->trace, TRACE_PAINT);
+    if (!window->render(&buffer->cairo, menu)) return false;
+    cairo_surface_flush(buffer->cairo.surface);
+    traceEnd(&menu->trace, TRACE_PAINT, 0);
+    latencyPainted(&menu->latency);
+    xcb_flush(window->connection);
+    latencyCommit(&menu->latency, NULL);
+    traceEnd(&menu->trace, TRACE_RENDER, buffer->height);
+
+    /* Nothing is shown yet, put the rest of the delay to use. */
+    cairoSpeculationStart(&window->speculation, &buffer->cairo, menu, window->width, window->root.h);
+
+    return true;
+}
+
+static void
+cleanup(Xcb* xcb)
+{
+    assert(xcb);
+
+    XcbWindow* window = &xcb->window;
+
+    cairoSpeculationFinish(&window->speculation, NULL);
+    destroyBuffer(&window->buffer);
+    cacheFree(&window->cellCache);
+    cacheFree(&window->chromeCache);
+    cairoTilesFree(&window->tiles);
+    keyTableFree(&window->keyTable);
+    xkb_state_unref(window->xkb.state);
+    xkb_keymap_unref(window->xkb.keymap);
+    xkb_context_unref(window->xkb.context);
+    if (window->delayFd >= 0) close(window->delayFd);
+    if (!xcb_connection_has_error(window->connection))
+    {
+        xcb_ungrab_keyboard(window->connection, XCB_CURRENT_TIME);
+        xcb_flush(window->connection);
+    }
+    xcb_disconnect(window->connection);
+}
+
+static void
+ungrabkeyboard(void* xp)
+{
+    Xcb*       xcb    = (Xcb*)xp;
+    XcbWindow* window = &xcb->window;
+
+    if (!window->grabbed) return;
+
+    xcb_ungrab_keyboard(window->connection, XCB_CURRENT_TIME);
+    xcb_flush(window->connection);
+    window->grabbed = false;
+}
+
+static bool
+grabkeyboard(Xcb* xcb, XcbWindow* window, xcb_grab_keyboard_cookie_t cookie)
+{
+    assert(xcb), assert(window);
+
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+    int             i;
+
+    /* try to grab keyboard, we may have to wait for another process to ungrab */
+    for (i = 0; i < 1000; i++)
+    {
+        xcb_grab_keyboard_reply_t* reply  = xcb_grab_keyboard_reply(window->connection, cookie, NULL);
+        uint8_t                    status = reply ? reply->status : XCB_GRAB_STATUS_FROZEN;
+        free(reply);
+
+        if (status == XCB_GRAB_STATUS_SUCCESS)
+        {
+            window->grabbed = true;
+            return true;
+        }
+
+        nanosleep(&ts, NULL);
+        cookie = xcb_grab_keyboard(
+            window->connection,
+            1,
+            window->screen->root,
+            XCB_CURRENT_TIME,
+            XCB_GRAB_MODE_ASYNC,
+            XCB_GRAB_MODE_ASYNC);
+    }
+
+    errorMsg("Could not grab keyboard.");
+    return false;
+}
+
+static bool
+regrabkeyboard(Xcb* xcb, XcbWindow* window)
+{
+    assert(xcb), assert(window);
+
+    xcb_grab_keyboard_cookie_t cookie = xcb_grab_keyboard(
+        window->connection,
+        1,
+        window->screen->root,
+        XCB_CURRENT_TIME,
+        XCB_GRAB_MODE_ASYNC,
+        XCB_GRAB_MODE_ASYNC);
+    return grabkeyboard(xcb, window, cookie);
+}
+
+static void
+setKeyMods(Key* key, uint16_t state)
+{
+    assert(key);
+
+    if (state & XCB_MOD_MASK_CONTROL) key->mods |= MOD_CTRL;
+    if (state & XCB_MOD_MASK_1) key->mods |= MOD_META;
+    if (state & XCB_MOD_MASK_4) key->mods |= MOD_HYPER;
+    if (state & XCB_MOD_MASK_SHIFT) key->mods |= MOD_SHIFT;
+}
+
+static SpecialKey
+keysymToSpecialKey(xkb_keysym_t keysym)
+{
+    for (size_t i = 0; i < specialkeysLen; i++)
+    {
+        if (specialkeys[i].keysym == keysym) return specialkeys[i].special;
+    }
+    return SPECIAL_KEY_NONE;
+}
+
+static bool
+xkbIsModifierKey(xkb_keysym_t keysym)
+{
+    return (
+        keysym == XKB_KEY_Shift_L || keysym == XKB_KEY_Shift_R ||
+        keysym == XKB_KEY_Control_L || keysym == XKB_KEY_Control_R ||
+        keysym == XKB_KEY_Caps_Lock || keysym == XKB_KEY_Shift_Lock ||
+        keysym == XKB_KEY_Meta_L || keysym == XKB_KEY_Meta_R ||
+        keysym == XKB_KEY_Alt_L || keysym == XKB_KEY_Alt_R ||
+        keysym == XKB_KEY_Super_L || keysym == XKB_KEY_Super_R ||
+        keysym == XKB_KEY_Hyper_L || keysym == XKB_KEY_Hyper_R);
+}
+
+/* Look the key up with the core state of the event minus the masked bits.
+ * The core modifier bits are the real modifiers of an X server keymap, and
+ * bits 13 and 14 carry the group. */
+static size_t
+maskedKeyUtf8(
+    XcbXkb*       xkb,
+    xcb_keycode_t keycode,
+    uint16_t      state,
+    char*         buffer,
+    size_t        size,
+    xkb_keysym_t* keysym,
+    uint16_t      mask)
+{
+    assert(xkb), assert(buffer), assert(keysym);
+
+    xkb_state_update_mask(xkb->state, state & mask & 0xff, 0, 0, 0, 0, (state >> 13) & 0x3);
+    *keysym = xkb_state_key_get_one_sym(xkb->state, keycode);
+    return xkb_state_key_get_utf8(xkb->state, keycode, buffer, size);
+}
+
+static bool
+shiftIsSignificant(const char* a, size_t aLen, const char* b, size_t bLen)
+{
+    assert(a), assert(b);
+
+    return (
+        aLen != bLen ||
+        memcmp(a, b, (aLen < bLen) ? aLen : bLen));
+}
+
+static size_t
+handleMysteryKeypress(Menu* menu, xkb_keysym_t keysym, char* reprBuf, size_t reprBufSize)
+{
+    assert(menu), assert(reprBuf);
+    debugMsg(menu->debug, "Checking mystery key.");
+
+    int len = xkb_keysym_get_name(keysym, reprBuf, reprBufSize);
+    if (len == 0)
+    {
+        warnMsg("[XCB]: Could not get keysym.");
+        return 0;
+    }
+    if (len < 0)
+    {
+        errorMsg("[XCB]: Invalid keysym.");
+        return 0;
+    }
+
+    return (size_t)len;
+}
+
+/* Translate a key event into the entry the key table keeps for it. */
+static void
+translateKey(XcbWindow* window, Menu* menu, xcb_key_press_event_t* keyEvent, KeyTableEntry* entry)
+{
+    assert(window), assert(menu), assert(keyEvent), assert(entry);
+
+    XcbXkb*      xkb     = &window->xkb;
+    xkb_keysym_t aKeysym = XKB_KEY_NoSymbol;
+    xkb_keysym_t bKeysym = XKB_KEY_NoSymbol;
+    size_t       reprLen = 0;
+
+    char   aBuffer[128] = { 0 };
+    size_t aLen         = maskedKeyUtf8(
+        xkb,
+        keyEvent->detail,
+        keyEvent->state,
+        aBuffer,
+        sizeof(aBuffer),
+        &aKeysym,
+        ~(XCB_MOD_MASK_CONTROL));
+
+    char   bBuffer[128] = { 0 };
+    size_t bLen         = maskedKeyUtf8(
+        xkb,
+        keyEvent->detail,
+        keyEvent->state,
+        bBuffer,
+        sizeof(bBuffer),
+        &bKeysym,
+        ~(XCB_MOD_MASK_SHIFT | XCB_MOD_MASK_CONTROL));
+
+    entry->keysym     = XKB_KEY_NoSymbol;
+    entry->special    = SPECIAL_KEY_NONE;
+    entry->reprLength = 0;
+    entry->repr[0]    = '\0';
+
+    if (xkbIsModifierKey(aKeysym) || xkbIsModifierKey(bKeysym)) return;
+
+    entry->shiftConsumed = shiftIsSignificant(aBuffer, aLen, bBuffer, bLen);
+    reprLen              = entry->shiftConsumed ? aLen : bLen;
+    entry->keysym        = entry->shiftConsumed ? aKeysym : bKeysym;
+    entry->special       = keysymToSpecialKey(entry->keysym);
+
+    char*  repr     = entry->repr;
+    size_t reprSize = sizeof(entry->repr);
+
+    if (reprLen > 0 && isNormalKey(entry->shiftConsumed ? aBuffer : bBuffer, reprLen))
+    {
+        const char* src   = entry->shiftConsumed ? aBuffer : bBuffer;
+        entry->reprLength = reprLen;
+        if (entry->reprLength >= reprSize) entry->reprLength = reprSize - 1;
+        memcpy(repr, src, entry->reprLength);
+        repr[entry->reprLength] = '\0';
+    }
+    else if (entry->special != SPECIAL_KEY_NONE)
+    {
+        const char* specialRepr = specialKeyRepr(entry->special);
+        entry->reprLength       = strlen(specialRepr);
+        if (entry->reprLength >= reprSize) entry->reprLength = reprSize - 1;
+        memcpy(repr, specialRepr, entry->reprLength);
+        repr[entry->reprLength] = '\0';
+    }
+    else
+    {
+        entry->reprLength = handleMysteryKeypress(menu, entry->keysym, repr, reprSize);
+    }
+}
+
+static Key
+makeKeyFromEvent(
+    XcbWindow*             window,
+    Menu*                  menu,
+    xcb_key_press_event_t* keyEvent,
+    char*                  reprBuf,
+    size_t                 reprBufSize)
+{
+    assert(window), assert(menu), assert(keyEvent), assert(reprBuf);
+    assert(reprBufSize > 0);
+
+    Key key = { 0 };
+    keyInit(&key);
+
+    const KeyTableEntry* entry = keyTableLookup(&window->keyTable, keyEvent->detail, keyEvent->state, 0);
+    KeyTableEntry        translated;
+    if (!entry)
+    {
+        translated = (KeyTableEntry){ .keycode = keyEvent->detail, .state = keyEvent->state };
+        translateKey(window, menu, keyEvent, &translated);
+        keyTableInsert(&window->keyTable, &translated);
+        entry = &translated;
+    }
+
+    size_t len = entry->reprLength;
+    if (len >= reprBufSize) len = reprBufSize - 1;
+    memcpy(reprBuf, entry->repr, len);
+    reprBuf[len] = '\0';
+
+    key.special = entry->special;
+    key.repr    = (String){ .data = reprBuf, .length = len };
+    if (len > 0)
+    {
+        setKeyMods(&key, entry->shiftConsumed ? keyEvent->state & ~(XCB_MOD_MASK_SHIFT) : keyEvent->state);
+    }
+
+    return key;
+}
+
+static MenuStatus
+keypress(XcbWindow* window, Menu* menu, xcb_key_press_event_t* keyEvent)
+{
+    assert(window), assert(menu), assert(keyEvent);
+
+    char reprBuf[128] = { 0 };
+    Key  key          = makeKeyFromEvent(window, menu, keyEvent, reprBuf, sizeof(reprBuf));
+    if (stringIsEmpty(&key.repr)) return MENU_STATUS_RUNNING;
+
+    traceInstant(&menu->trace, TRACE_KEY, keyEvent->detail);
+    latencyKey(&menu->latency, keyEvent->time);
+    MenuStatus status = menuHandleKeypress(menu, &key);
+    latencyHandled(&menu->latency, status == MENU_STATUS_DAMAGED);
+
+    keyFree(&key);
+    return status;
+}
+
+/* Sleep until the connection is readable, the menu delay or the +keep
+ * deadline runs out, or a sync command exits. Returns false if polling
+ * failed. */
+static bool
+waitForEvent(XcbWindow* window, Menu* menu, bool* delayExpired)
+{
+    assert(window), assert(menu), assert(delayExpired);
+
+    uint32_t delay     = menuDelayRemaining(menu);
+    uint32_t remaining = menuWaitRemaining(menu);
+    int      timeout   = -1;
+
+    *delayExpired = false;
+
+    if (remaining && window->delayFd >= 0)
+    {
+        struct itimerspec its = {
+            .it_interval.tv_sec  = 0,
+            .it_interval.tv_nsec = 0,
+            .it_value.tv_sec     = remaining / 1000,
+            .it_value.tv_nsec    = (remaining % 1000) * 1000000,
+        };
+        timerfd_settime(window->delayFd, 0, &its, NULL);
+    }
+    else if (remaining)
+    {
+        /* No timer available, let poll time out instead. */
+        timeout = (int)remaining;
+    }
+
+    if (xcb_flush(window->connection) <= 0) return false;
+
+    /* poll skips the timer entry if it could not be created, and the command
+     * entry unless a sync command is running. */
+    struct pollfd fds[] = {
+        { .fd = xcb_get_file_descriptor(window->connection), .events = POLLIN },
+        { .fd = window->delayFd,                             .events = POLLIN },
+        { .fd = menuCommandFd(menu),                         .events = POLLIN },
+    };
+
+    traceBegin(&menu->trace, TRACE_WAIT);
+    int ready = poll(fds, 3, timeout);
+    traceEnd(&menu->trace, TRACE_WAIT, ready);
+    if (ready < 0 && errno != EINTR) return false;
+
+    if (ready > 0 && (fds[1].revents & POLLIN))
+    {
+        uint64_t expirations;
+        if (read(window->delayFd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) return false;
+    }
+
+    if (ready > 0 && (fds[2].revents & POLLIN)) menuContinueCommands(menu);
+
+    /* The timer also wakes up for the +keep deadline, only report the delay. */
+    *delayExpired = delay && !menuDelayRemaining(menu);
+
+    return true;
+}
+
+/* Returns false once the menu is done, with the exit status in result. */
+static bool
+handleEvent(Xcb* xcb, XcbWindow* window, Menu* menu, xcb_generic_event_t* ev, int* result)
+{
+    assert(xcb), assert(window), assert(menu), assert(ev), assert(result);
+
+    *result = EX_SOFTWARE;
+
+    switch (ev->response_type & ~0x80)
+    {
+    case XCB_DESTROY_NOTIFY:
+    {
+        xcb_destroy_notify_event_t* destroy = (xcb_destroy_notify_event_t*)ev;
+        if (destroy->window != window->drawable) break;
+        return false;
+    }
+    case XCB_EXPOSE:
+    {
+        /* Collect the exposed areas and redraw them once the queue is
+         * empty. */
+        xcb_expose_event_t* expose = (xcb_expose_event_t*)ev;
+        if (window->buffer.created)
+        {
+            cairo_rectangle_int_t rect = {
+                .x      = expose->x,
+                .y      = expose->y,
+                .width  = expose->width,
+                .height = expose->height,
+            };
+            cairoInvalidate(&window->buffer.cairo, &rect);
+        }
+        if (expose->count == 0) window->damaged = true;
+        break;
+    }
+    case XCB_KEY_PRESS:
+    {
+        /* The grab is held across keypresses. The menu only releases
+         * it to run a command, see ungrabkeyboard. */
+        MenuStatus status = keypress(window, menu, (xcb_key_press_event_t*)ev);
+
+        switch (status)
+        {
+        case MENU_STATUS_RUNNING:
+        case MENU_STATUS_DAMAGED:
+            /* Menu is still active, regrab keyboard after a +keep command
+             * unless the command's deadline is still running. */
+            if (!window->grabbed && !menu->keepPending && !regrabkeyboard(xcb, window)) return false;
+
+            if (status == MENU_STATUS_DAMAGED) window->damaged = true;
+            break;
+        case MENU_STATUS_EXIT_OK: *result = EX_OK; return false;
+        case MENU_STATUS_EXIT_SOFTWARE: return false;
+        }
+        break;
+    }
+    case XCB_BUTTON_PRESS: return false;
+    case XCB_MAPPING_NOTIFY:
+    {
+        /* Translations made with the old keymap no longer hold. */
+        xcb_mapping_notify_event_t* mapping = (xcb_mapping_notify_event_t*)ev;
+        if (mapping->request == XCB_MAPPING_KEYBOARD && !initKeymap(window)) return false;
+        break;
+    }
+    case XCB_VISIBILITY_NOTIFY:
+    {
+        xcb_visibility_notify_event_t* visibility = (xcb_visibility_notify_event_t*)ev;
+        if (visibility->state != XCB_VISIBILITY_UNOBSCURED)
+        {
+            const uint32_t stackMode = XCB_STACK_MODE_ABOVE;
+            xcb_configure_window(window->connection, window->drawable, XCB_CONFIG_WINDOW_STACK_MODE, &stackMode);
+            xcb_flush(window->connection);
+        }
+        break;
+    }
+    }
+
+    return true;
+}
+
+static int
+eventHandler(Xcb* xcb, XcbWindow* window, Menu* menu)
+{
+    assert(xcb), assert(window), assert(menu);
+
+    while (true)
+    {
+        traceCheckDump(&menu->trace);
+
+        /* The +keep deadline passed, take the keyboard back. */
+        if (menuKeepExpired(menu) && !window->grabbed && !regrabkeyboard(xcb, window)) return EX_SOFTWARE;
+
+        xcb_generic_event_t* ev = xcb_poll_for_event(window->connection);
+        if (!ev)
+        {
+            if (xcb_connection_has_error(window->connection))
+            {
+                errorMsg("Lost the connection to the X server.");
+                return EX_SOFTWARE;
+            }
+
+            /* Every queued event has been handled, draw the outcome once
+             * instead of each level a burst of keys passed through. */
+            if (window->damaged)
+            {
+                window->damaged = false;
+                if (!render(window, menu)) return EX_SOFTWARE;
+                continue;
+            }
+
+            /* Nothing is queued, draw what the most used prefixes of this
+             * level show before going to sleep. */
+            if (window->prefetched != menu->keyChords && window->buffer.created)
+            {
+                window->prefetched = menu->keyChords;
+                cairoPrefetch(&window->buffer.cairo, menu, window->width, window->root.h);
+                continue;
+            }
+
+            bool delayExpired = false;
+            if (!waitForEvent(window, menu, &delayExpired))
+            {
+                errorMsg("Could not wait for X11 events.");
+                return EX_SOFTWARE;
+            }
+
+            /* The menu was held back by the delay, show it now. */
+            if (delayExpired && !render(window, menu)) return EX_SOFTWARE;
+            continue;
+        }
+
+        int  result  = EX_OK;
+        bool running = handleEvent(xcb, window, menu, ev, &result);
+        free(ev);
+        if (!running) return result;
+    }
+
+    return EX_OK;
+}
+
+int
+xcbRun(Menu* menu)
+{
+    assert(menu);
+
+    int            result  = EX_SOFTWARE;
+    StartupCookies cookies = { 0 };
+    checkLocale(menu);
+    Xcb xcb            = { 0 };
+    xcb.menu           = menu;
+    xcb.window.delayFd = -1;
+    menu->ungrabfp     = ungrabkeyboard;
+    menu->xp           = &xcb;
+    if (!initXcb(&xcb, &xcb.window, menu, &cookies))
+    {
+        errorMsg("Could not initialize xcb.");
+    }
+    else if (grabkeyboard(&xcb, &xcb.window, cookies.grab) && render(&xcb.window, menu))
+    {
+        result = eventHandler(&xcb, &xcb.window, menu);
+    }
+    cleanup(&xcb);
+    return result;
+}
@@ -0,0 +1,69 @@
+#ifndef WK_XCB_WINDOW_H_
+#define WK_XCB_WINDOW_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <xcb/xcb.h>
+#include <xkbcommon/xkbcommon.h>
+
+#include "../cairo.h"
+#include "../key_table.h"
+
+typedef struct
+{
+    Cairo    cairo;
+    uint32_t width;
+    uint32_t height;
+    bool     created;
+} Buffer;
+
+typedef struct
+{
+    struct xkb_context* context;
+    struct xkb_keymap*  keymap;
+    struct xkb_state*   state;
+    int32_t             deviceId;
+} XcbXkb;
+
+typedef struct
+{
+    xcb_connection_t* connection;
+    xcb_screen_t*     screen;
+    xcb_window_t      drawable;
+    xcb_visualtype_t* visual;
+    uint8_t           depth;
+    int               delayFd;
+    Buffer            buffer;
+    XcbXkb            xkb;
+    uint32_t          x;
+    uint32_t          y;
+    uint32_t          width;
+    uint32_t          height;
+    uint32_t          border;
+    uint32_t          maxHeight;
+    bool              grabbed;
+    bool              damaged;
+    struct display
+    {
+        uint32_t x, y, w, h;
+    } root;
+    CairoPaint       paint;
+    Cache            cellCache;
+    Cache            chromeCache;
+    CairoTiles       tiles;
+    CairoSpeculation speculation;
+    KeyTable         keyTable;
+    Span*            prefetched;
+    bool (*render)(Cairo* cairo, Menu* menu);
+} XcbWindow;
+
+typedef struct
+{
+    xcb_connection_t* connection;
+    XcbWindow         window;
+    Menu*             menu;
+} Xcb;
+
+int xcbRun(Menu* menu);
+
+#endif /* WK_XCB_WINDOW_H_ */
@@ -0,0 +1,399 @@
+#!/usr/bin/env bash
+# Benchmarks for wk
+# Runs ./wk and prints timings taken from --trace
+
+set -uo pipefail
+
+# Options
+RUNS=10
+CHORDS=240
+COLUMNS=12
+THREADS="0 2 4 8"
+SETTLE=0.5
+WK="./wk"
+
+usage() {
+    echo "Usage: $0 [OPTIONS] MODE"
+    echo ""
+    echo "Modes:"
+    echo "  tiles                 First frame render time for each --render-threads"
+    echo "                        value (experimental option)"
+    echo "  present               First frame render and present time with and without"
+    echo "                        --client-render (X11)"
+    echo "  spawn                 Time from spawning a no-op command until it is exec'd"
+    echo "  startup               Time to the first frame and to the input method being"
+    echo "                        ready, with and without XMODIFIERS (X11)"
+    echo "  keys                  Key-to-frame latency stepping through nested prefixes"
+    echo "                        (X11, needs xdotool)"
+    echo ""
+    echo "Options:"
+    echo "  --runs N              Runs per configuration (default $RUNS)"
+    echo "  --chords N            Chords in the generated menu, at most 288 (default $CHORDS)"
+    echo "  --columns N           Passed as --max-columns (default $COLUMNS)"
+    echo "  --threads LIST        --render-threads values for tiles (default \"$THREADS\")"
+    echo "  --settle SECONDS      Time given to wk before the trace is taken (default $SETTLE)"
+    echo "  --wk PATH             wk binary to run (default $WK)"
+    echo "  -h, --help            Show this help"
+    echo ""
+    echo "Modes that draw need a display, X11 or Wayland. The output scale is the"
+    echo "display's, run them on a HiDPI output to measure HiDPI frames. Compare"
+    echo "builds by running each mode with --wk pointing at each binary."
+}
+
+MODE=""
+
+# Parse command line arguments
+while [[ $# -gt 0 ]]; do
+    case "$1" in
+    --runs)
+        RUNS="$2"
+        shift 2
+        ;;
+    --chords)
+        CHORDS="$2"
+        shift 2
+        ;;
+    --columns)
+        COLUMNS="$2"
+        shift 2
+        ;;
+    --threads)
+        THREADS="$2"
+        shift 2
+        ;;
+    --settle)
+        SETTLE="$2"
+        shift 2
+        ;;
+    --wk)
+        WK="$2"
+        shift 2
+        ;;
+    -h | --help)
+        usage
+        exit 0
+        ;;
+    -*)
+        echo "Unknown option: $1"
+        exit 1
+        ;;
+    *)
+        MODE="$1"
+        shift
+        ;;
+    esac
+done
+
+if [[ -z "$MODE" ]]; then
+    usage
+    exit 1
+fi
+
+if [[ ! -x "$WK" ]]; then
+    echo "No wk binary at '$WK', build it first."
+    exit 1
+fi
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# Write a menu of CHORDS chords with long descriptions, every key with its
+# own modifiers so none of them collide.
+make_menu() {
+    local file="$1"
+    local mods=("" "C-" "M-" "H-" "C-M-" "C-H-" "M-H-" "C-M-H-")
+    local keys="abcdefghijklmnopqrstuvwxyz0123456789"
+    local count=0
+
+    : >"$file"
+    for mod in "${mods[@]}"; do
+        for ((i = 0; i < ${#keys}; i++)); do
+            ((count >= CHORDS)) && return
+            printf '%s%s "Chord %d with a description long enough to shape" %%{{true}}\n' \
+                "$mod" "${keys:i:1}" "$count" >>"$file"
+            ((count++))
+        done
+    done
+}
+
+# Write a menu of prefixes nested as deep as KEYS is long, the last key runs
+# a no-op and closes the menu.
+make_chain() {
+    local file="$1"
+    shift
+    local depth=$#
+    local level=0
+
+    : >"$file"
+    for key in "$@"; do
+        ((level++))
+        if ((level < depth)); then
+            printf '%s "Level %d" {\n' "$key" "$level" >>"$file"
+        else
+            printf '%s "Level %d" %%{{true}}\n' "$key" "$level" >>"$file"
+        fi
+    done
+    for ((level = 1; level < depth; level++)); do
+        echo "}" >>"$file"
+    done
+}
+
+need_display() {
+    if [[ -z "${DISPLAY:-}" && -z "${WAYLAND_DISPLAY:-}" ]]; then
+        echo "No display to draw on, set DISPLAY or WAYLAND_DISPLAY."
+        exit 1
+    fi
+}
+
+# Print the duration in milliseconds of each NAME span in a trace, or of
+# those whose end carries ARG if one is given.
+spans() {
+    local trace="$1"
+    local name="$2"
+    local arg="${3:-}"
+
+    awk -v name="$name" -v arg="$arg" '
+    index($0, "\"name\":\"" name "\"") {
+        match($0, /"ts":[0-9.]+/)
+        ts = substr($0, RSTART + 5, RLENGTH - 5)
+        if ($0 ~ /"ph":"B"/) {
+            begin = ts
+        } else if ($0 ~ /"ph":"E"/ && begin != "") {
+            if (arg == "" || index($0, "\"arg\":" arg "}")) printf "%.3f\n", (ts - begin) / 1000
+            begin = ""
+        }
+    }' "$trace"
+}
+
+# Print the render span of the first frame and the part of it after the
+# paint span, getting the pixels to the server, in milliseconds.
+first_frame() {
+    local trace="$1"
+
+    awk '
+    /"name":"(render|paint)"/ {
+        name = $0 ~ /"name":"render"/ ? "render" : "paint"
+        match($0, /"ts":[0-9.]+/)
+        ts = substr($0, RSTART + 5, RLENGTH - 5)
+        if ($0 ~ /"ph":"B"/ && !(name in begin)) {
+            begin[name] = ts
+        } else if ($0 ~ /"ph":"E"/ && (name in begin) && !(name in span)) {
+            span[name] = ts - begin[name]
+        }
+        if ("render" in span && "paint" in span) {
+            printf "%.3f %.3f\n", span["render"] / 1000, (span["render"] - span["paint"]) / 1000
+            exit
+        }
+    }' "$trace"
+}
+
+# Print the milliseconds from the start instant to the end of the first
+# NAME span in a trace.
+since_start() {
+    local trace="$1"
+    local name="$2"
+
+    awk -v name="$name" '
+    /"name":"start"/ {
+        match($0, /"ts":[0-9.]+/)
+        start = substr($0, RSTART + 5, RLENGTH - 5)
+    }
+    index($0, "\"name\":\"" name "\"") && /"ph":"E"/ && start != "" {
+        match($0, /"ts":[0-9.]+/)
+        printf "%.3f\n", (substr($0, RSTART + 5, RLENGTH - 5) - start) / 1000
+        exit
+    }' "$trace"
+}
+
+# Print min, median, and mean of the numbers on stdin.
+summarize() {
+    sort -n | awk '
+    { values[NR] = $1; total += $1 }
+    END {
+        if (NR == 0) { print "no samples"; exit }
+        median = NR % 2 ? values[(NR + 1) / 2] : (values[NR / 2] + values[NR / 2 + 1]) / 2
+        printf "min %8.3f ms  median %8.3f ms  mean %8.3f ms  (%d runs)\n", values[1], median, total / NR, NR
+    }'
+}
+
+# Start wk with ARGS on MENU, give it SETTLE seconds to show the menu, have
+# it write its trace, and close it. Prints the trace path, its stderr is kept
+# next to it.
+run_traced() {
+    local menu="$1"
+    shift
+    local trace="$WORK_DIR/trace.json"
+
+    rm -f "$trace"
+    "$WK" --key-chords "$menu" --delay 0 --trace "$trace" "$@" >/dev/null 2>"$WORK_DIR/stderr.txt" &
+    local pid=$!
+
+    sleep "$SETTLE"
+    kill -USR1 "$pid" 2>/dev/null
+    sleep 0.2
+    kill "$pid" 2>/dev/null
+    wait "$pid" 2>/dev/null
+
+    echo "$trace"
+}
+
+bench_tiles() {
+    local menu="$WORK_DIR/menu.wks"
+
+    need_display
+    make_menu "$menu"
+
+    echo "First frame render, $CHORDS chords, up to $COLUMNS columns:"
+    for threads in $THREADS; do
+        printf "  %-18s " "--render-threads $threads"
+        for ((run = 0; run < RUNS; run++)); do
+            local trace
+            trace=$(run_traced "$menu" --max-columns "$COLUMNS" --render-threads "$threads")
+            [[ -s "$trace" ]] && spans "$trace" render | head -n 1
+        done | summarize
+    done
+}
+
+# Which path --client-render presents with on this display. Remote servers
+# refuse MIT-SHM and get XPutImage.
+present_path() {
+    local menu="$1"
+
+    run_traced "$menu" --client-render --debug >/dev/null
+    if grep -q "MIT-SHM unavailable\|falling back to XPutImage" "$WORK_DIR/stderr.txt"; then
+        echo "XPutImage"
+    else
+        echo "MIT-SHM"
+    fi
+}
+
+bench_present() {
+    local menu="$WORK_DIR/menu.wks"
+    local results="$WORK_DIR/present.txt"
+
+    need_display
+    make_menu "$menu"
+
+    echo "First frame, $CHORDS chords, up to $COLUMNS columns:"
+    for flags in "" "--client-render"; do
+        local label="Xlib surface"
+        [[ -n "$flags" ]] && label="$(present_path "$menu")"
+
+        : >"$results"
+        for ((run = 0; run < RUNS; run++)); do
+            local trace
+            trace=$(run_traced "$menu" --max-columns "$COLUMNS" $flags)
+            [[ -s "$trace" ]] && first_frame "$trace" >>"$results"
+        done
+
+        printf "  %-18s render   " "$label"
+        cut -d' ' -f1 "$results" | summarize
+        printf "  %-18s present  " ""
+        cut -d' ' -f2 "$results" | summarize
+    done
+}
+
+# The input method is opened after the first frame, so a slow one should
+# only move its own line. "@im=none" keeps Xlib off any IM server.
+bench_startup() {
+    local menu="$WORK_DIR/menu.wks"
+    local results="$WORK_DIR/startup.txt"
+    local modifiers=("@im=none")
+
+    need_display
+    make_menu "$menu"
+    [[ -n "${XMODIFIERS:-}" && "$XMODIFIERS" != "@im=none" ]] && modifiers+=("$XMODIFIERS")
+
+    echo "From tracing start, before the display is opened:"
+    for im in "${modifiers[@]}"; do
+        : >"$results"
+        for ((run = 0; run < RUNS; run++)); do
+            local trace
+            trace=$(XMODIFIERS="$im" run_traced "$menu" --max-columns "$COLUMNS")
+            [[ -s "$trace" ]] && echo "$(since_start "$trace" render) $(since_start "$trace" input-method)" >>"$results"
+        done
+
+        printf "  %-24s first frame   " "XMODIFIERS=$im"
+        cut -d' ' -f1 "$results" | summarize
+        printf "  %-24s input method  " ""
+        cut -d' ' -f2 "$results" | summarize
+    done
+    [[ ${#modifiers[@]} -eq 1 ]] && echo "Set XMODIFIERS to an input method, e.g. @im=ibus, to compare with it."
+}
+
+# Every key but the last opens a prefix, which is where the grab used to be
+# dropped and taken again. Each run adds the mean of every --latency stage.
+bench_keys() {
+    local menu="$WORK_DIR/chain.wks"
+    local report="$WORK_DIR/latency.txt"
+    local results="$WORK_DIR/keys.txt"
+    local keys=(a b c d e f g h)
+
+    need_display
+    if ! command -v xdotool >/dev/null; then
+        echo "The keys mode needs xdotool to send key presses."
+        exit 1
+    fi
+    make_chain "$menu" "${keys[@]}"
+
+    : >"$results"
+    for ((run = 0; run < RUNS; run++)); do
+        rm -f "$report"
+        "$WK" --key-chords "$menu" --delay 0 --latency "$report" >/dev/null 2>&1 &
+        local pid=$!
+
+        sleep "$SETTLE"
+        xdotool key --delay 30 "${keys[@]}"
+        local tries=0
+        while kill -0 "$pid" 2>/dev/null && ((tries++ < 50)); do
+            sleep 0.1
+        done
+        kill "$pid" 2>/dev/null
+        wait "$pid" 2>/dev/null
+
+        [[ -s "$report" ]] && awk '$1 ~ /^(handled|painted|committed|presented)$/ && NF == 7 { print $1, $3 }' "$report" >>"$results"
+    done
+
+    echo "Key-to-frame latency, ${#keys[@]} keys through nested prefixes, mean per run:"
+    for stage in handled painted committed presented; do
+        grep -q "^$stage " "$results" || continue
+        printf "  %-18s " "$stage"
+        grep "^$stage " "$results" | cut -d' ' -f2 | summarize
+    done
+}
+
+# Spawn spans end with the command kind: 2 is exec'd directly, 3 through
+# the shell. posix_spawn returns once the child has exec'd, so a span is
+# the time from the spawn call until the command runs.
+bench_spawn() {
+    local menu="$WORK_DIR/spawn.wks"
+    local trace="$WORK_DIR/trace.json"
+
+    cat >"$menu" <<'WKS'
+d "Direct" ^sync-before %{{true}} ^sync-after %{{true}} %{{true}}
+s "Shell" ^sync-before %{{true;}} ^sync-after %{{true;}} %{{true;}}
+WKS
+
+    echo "Spawn to exec of a no-op command, three per chord:"
+    for kind in "d 2 direct" "s 3 shell"; do
+        set -- $kind
+        printf "  %-18s " "$3"
+        for ((run = 0; run < RUNS; run++)); do
+            rm -f "$trace"
+            "$WK" --key-chords "$menu" --press "$1" --trace "$trace" >/dev/null 2>&1
+            [[ -s "$trace" ]] && spans "$trace" spawn "$2"
+        done | summarize
+    done
+}
+
+case "$MODE" in
+tiles) bench_tiles ;;
+present) bench_present ;;
+spawn) bench_spawn ;;
+startup) bench_startup ;;
+keys) bench_keys ;;
+*)
+    echo "Unknown mode: $MODE"
+    exit 1
+    ;;
+esac
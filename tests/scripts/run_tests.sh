@@ -157,16 +157,16 @@ parse_tests() {
             skip_reason = ""
         }
 
-        # Parse new test
-        match($0, /"([^"]+)"/, arr)
-        current_keys = arr[1]
+        # Parse new test (POSIX match, mawk has no capture groups)
+        match($0, /"[^"]+"/)
+        current_keys = substr($0, RSTART + 1, RLENGTH - 2)
         current_expect = ""
         current_desc = ""
         in_multiline = 0
 
         # Check for -> description
-        if (match($0, /->[ ]*(.+)$/, desc_arr)) {
-            current_desc = desc_arr[1]
+        if (match($0, /->[ ]*/)) {
+            current_desc = substr($0, RSTART + RLENGTH)
         }
         next
     }
@@ -0,0 +1,118 @@
+/* Keys queued while a frame is drawn must be translated under the modifiers
+ * they were pressed with, not the ones live when the queue drains. Built and
+ * run by `make test-wayland` against the real xkbcommon "us" keymap. */
+
+#include <stdio.h>
+#include <xkbcommon/xkbcommon-names.h>
+
+#include "runtime/wayland/wayland.c"
+
+/* evdev KEY_A plus the xkb keycode offset. */
+#define KEYCODE_A 38
+
+static int failures = 0;
+
+static void
+expectKey(const char* what, const Key* key, const char* repr, bool shifted)
+{
+    assert(what), assert(key), assert(repr);
+
+    bool reprOk  = key->repr.length == strlen(repr) && !memcmp(key->repr.data, repr, key->repr.length);
+    bool shiftOk = !!(key->mods & MOD_SHIFT) == shifted;
+    if (reprOk && shiftOk) return;
+
+    fprintf(
+        stderr,
+        "FAIL %s: got '%.*s'%s, want '%s'%s\n",
+        what,
+        (int)key->repr.length,
+        key->repr.data ? key->repr.data : "",
+        key->mods & MOD_SHIFT ? " with shift" : "",
+        repr,
+        shifted ? " with shift" : "");
+    failures++;
+}
+
+/* Set the live modifier state, as keyboardHandleModifiers would. */
+static void
+setLiveMods(Input* input, uint32_t depressed, uint32_t modifiers)
+{
+    assert(input);
+
+    input->xkb.depressedMods = depressed;
+    input->modifiers         = modifiers;
+    xkbStateRestoreMask(&input->xkb);
+}
+
+static Key
+drainKey(Wayland* wayland, Menu* menu, PendingKey* pending, char* reprBuf, size_t reprBufSize)
+{
+    assert(wayland), assert(menu), assert(pending), assert(reprBuf);
+
+    xkb_keysym_t keysym;
+    size_t       reprLen = 0;
+    return makePendingKey(wayland, menu, pending, &keysym, reprBuf, reprBufSize, &reprLen);
+}
+
+int
+main(void)
+{
+    Wayland wayland = { 0 };
+    Menu    menu    = { 0 };
+    Input*  input   = &wayland.input;
+    Xkb*    xkb     = &input->xkb;
+
+    struct xkb_rule_names names = { .layout = "us" };
+
+    xkb->context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    xkb->keymap  = xkb_keymap_new_from_names(xkb->context, &names, XKB_KEYMAP_COMPILE_NO_FLAGS);
+    if (!xkb->keymap)
+    {
+        fprintf(stderr, "FAIL could not compile the 'us' keymap\n");
+        return 1;
+    }
+
+    xkb->state             = xkb_state_new(xkb->keymap);
+    xkb->masks[MASK_SHIFT] = 1 << xkb_keymap_mod_get_index(xkb->keymap, XKB_MOD_NAME_SHIFT);
+    xkb->masks[MASK_CTRL]  = 1 << xkb_keymap_mod_get_index(xkb->keymap, XKB_MOD_NAME_CTRL);
+    keyTableInit(&input->keyTable);
+
+    uint32_t shift   = xkb->masks[MASK_SHIFT];
+    char     buf[32] = { 0 };
+
+    /* Shift+a is queued, then Shift is released before the queue drains. */
+    PendingKey shifted = { .code = KEYCODE_A, .modifiers = XKB_MOD_SHIFT, .depressedMods = shift };
+    setLiveMods(input, 0, 0);
+    Key key = drainKey(&wayland, &menu, &shifted, buf, sizeof(buf));
+    expectKey("shift released mid-batch", &key, "A", false);
+
+    if (xkb->depressedMods != 0 || input->modifiers != 0 ||
+        xkb_state_serialize_mods(xkb->state, XKB_STATE_MODS_EFFECTIVE) != 0)
+    {
+        fprintf(stderr, "FAIL live modifier state was not put back\n");
+        failures++;
+    }
+
+    /* The entry cached for the shifted press must not answer a bare one. */
+    PendingKey bare = { .code = KEYCODE_A };
+
+    key = drainKey(&wayland, &menu, &bare, buf, sizeof(buf));
+    expectKey("bare key after a shifted one", &key, "a", false);
+
+    /* And the other way round: a bare key queued before Shift goes down. */
+    setLiveMods(input, shift, XKB_MOD_SHIFT);
+    key = drainKey(&wayland, &menu, &bare, buf, sizeof(buf));
+    expectKey("shift pressed mid-batch", &key, "a", false);
+
+    key = drainKey(&wayland, &menu, &shifted, buf, sizeof(buf));
+    expectKey("cached shifted key", &key, "A", false);
+
+    keyTableFree(&input->keyTable);
+    xkb_state_unref(xkb->state);
+    xkb_keymap_unref(xkb->keymap);
+    xkb_context_unref(xkb->context);
+
+    if (failures) return 1;
+    printf("pending_keys: ok\n");
+    return 0;
+}